@@ -1,14 +1,127 @@
 -- premake5.lua
+newoption {
+    trigger = "aot-rom",
+    value = "path",
+    description = "Translate a rom with chip8-aot and build it into CHIP8 for --engine aot, e.g. --aot-rom=roms/pong.ch8"
+}
+
+newoption {
+    trigger = "opcode-table",
+    description = "Build the 65536 handler opcode engine (--engine opcode), adds minutes of build time and about 10 MB of code"
+}
+
 workspace "CHIP8"
     configurations { "Debug", "Release" }
     platforms {"X64"}
 
+    -- The engine list is in chip8.h, so the core and everything including it has to agree
+    if _OPTIONS["opcode-table"] then
+        defines { "CHIP8_OPCODE_TABLE=1" }
+    end
+
+-- The emulator without SDL, GL or ImGui, the app and the tools link it
+project "chip8-core"
+    kind "StaticLib"
+    language "C++"
+    targetdir "build/%{cfg.buildcfg}"
+    includedirs { "src" }
+    files { "src/core/**.h", "src/core/**.cpp" }
+
+    filter "configurations:Debug"
+        defines { "DEBUG" }
+        symbols "On"
+
+    filter "configurations:Release"
+        defines { "NDEBUG" }
+        optimize "On"
+
+-- The SDL/ImGui frontend
 project "CHIP8"
     kind "ConsoleApp"
     language "C++"
     targetdir "build/%{cfg.buildcfg}"
-    links {"dl", "GL", "SDL2"}
+    includedirs { "src" }
+    links {"chip8-core", "dl", "GL", "SDL2", "pthread"}
     files { "src/**.h", "src/**.cpp" }
+    removefiles { "src/tools/**", "src/core/**" }
+
+    if _OPTIONS["aot-rom"] then
+        dependson { "chip8-aot" }
+        includedirs { "src" }
+        files { "build/aot/aot_rom.cpp" }
+        prebuildcommands {
+            "{MKDIR} %{wks.location}/build/aot",
+            "%{wks.location}/build/%{cfg.buildcfg}/chip8-aot %{wks.location}/" .. _OPTIONS["aot-rom"] .. " %{wks.location}/build/aot/aot_rom.cpp"
+        }
+    end
+
+    filter "configurations:Debug"
+        defines { "DEBUG" }
+        symbols "On"
+
+    filter "configurations:Release"
+        defines { "NDEBUG" }
+        optimize "On"
+
+-- Translates a rom to C++, see src/tools/chip8_aot.cpp
+project "chip8-aot"
+    kind "ConsoleApp"
+    language "C++"
+    targetdir "build/%{cfg.buildcfg}"
+    links {"chip8-core", "dl"}
+    includedirs { "src" }
+    files { "src/tools/chip8_aot.cpp" }
+
+    filter "configurations:Debug"
+        defines { "DEBUG" }
+        symbols "On"
+
+    filter "configurations:Release"
+        defines { "NDEBUG" }
+        optimize "On"
+
+-- Counts back to back instruction pairs over roms/, see src/tools/chip8_pairs.cpp
+project "chip8-pairs"
+    kind "ConsoleApp"
+    language "C++"
+    targetdir "build/%{cfg.buildcfg}"
+    links {"chip8-core", "dl"}
+    includedirs { "src" }
+    files { "src/tools/chip8_pairs.cpp" }
+
+    filter "configurations:Debug"
+        defines { "DEBUG" }
+        symbols "On"
+
+    filter "configurations:Release"
+        defines { "NDEBUG" }
+        optimize "On"
+
+-- Runs a rom headless and uncapped, see src/tools/chip8_run.cpp
+project "chip8-run"
+    kind "ConsoleApp"
+    language "C++"
+    targetdir "build/%{cfg.buildcfg}"
+    links {"chip8-core", "dl"}
+    includedirs { "src" }
+    files { "src/tools/chip8_run.cpp" }
+
+    filter "configurations:Debug"
+        defines { "DEBUG" }
+        symbols "On"
+
+    filter "configurations:Release"
+        defines { "NDEBUG" }
+        optimize "On"
+
+-- Microbenchmark of the 1bpp to RGBA kernels, see src/tools/chip8_expand.cpp
+project "chip8-expand"
+    kind "ConsoleApp"
+    language "C++"
+    targetdir "build/%{cfg.buildcfg}"
+    links {"chip8-core", "dl"}
+    includedirs { "src" }
+    files { "src/tools/chip8_expand.cpp" }
 
     filter "configurations:Debug"
         defines { "DEBUG" }
@@ -16,4 +129,4 @@ project "CHIP8"
 
     filter "configurations:Release"
         defines { "NDEBUG" }
-        optimize "On"
\ No newline at end of file
+        optimize "On"
@@ -0,0 +1,33 @@
+#include "aot.h"
+
+AotProgram *aot_programs = NULL;
+
+static bool matches(const AotProgram &program, const CHIP_8 &chip, int start, int end)
+{
+    return !memcmp(chip.memory + start, program.rom + (start - 0x200), end - start);
+}
+
+const AotProgram *aot_find(const CHIP_8 &chip)
+{
+    for (const AotProgram *program = aot_programs; program; program = program->next)
+    {
+        bool found = program->platform == chip.platform;
+        for (int r = 0; r < program->range_count && found; r++)
+            found = matches(*program, chip, program->ranges[r][0], program->ranges[r][1]);
+        if (found)
+            return program;
+    }
+    return NULL;
+}
+
+bool aot_intact(const AotProgram &program, const CHIP_8 &chip, int addr, int length)
+{
+    for (int r = 0; r < program.range_count; r++)
+    {
+        int start = program.ranges[r][0] > addr ? program.ranges[r][0] : addr;
+        int end = program.ranges[r][1] < addr + length ? program.ranges[r][1] : addr + length;
+        if (start < end && !matches(program, chip, start, end))
+            return false;
+    }
+    return true;
+}
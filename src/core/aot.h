@@ -0,0 +1,39 @@
+#pragma once
+
+#include "chip8.h"
+
+// Runs a translated rom for the given cycles and returns the ones it didn't get to, which is
+// only non-zero once the guest wrote over translated code and the interpreter has to take over
+typedef int (*AotRun)(CHIP_8 &chip, int cycles);
+
+// A rom translated to C++ by chip8-aot, the generated file registers it at startup
+struct AotProgram
+{
+    const char *name;
+    // Quirks the code was translated with, see quirks.h
+    Platform platform;
+    const unsigned char *rom;
+    int rom_size;
+    // [start, end) of the translated instructions, the program is only used while these bytes match the rom
+    const unsigned short (*ranges)[2];
+    int range_count;
+    AotRun run;
+    AotProgram *next;
+};
+
+extern AotProgram *aot_programs;
+
+struct AotRegister
+{
+    AotRegister(AotProgram *program)
+    {
+        program->next = aot_programs;
+        aot_programs = program;
+    }
+};
+
+// The translated program whose code is in memory, NULL if there is none
+const AotProgram *aot_find(const CHIP_8 &chip);
+
+// False if [addr, addr + length) overlaps translated code that no longer matches the rom
+bool aot_intact(const AotProgram &program, const CHIP_8 &chip, int addr, int length);
@@ -0,0 +1,1379 @@
+#include "chip8.h"
+#include "jit_x64.h"
+#include "aot.h"
+#include <chrono>
+
+// Labels-as-values are a GCC/Clang extension, other compilers get the switch fallback
+#ifndef CHIP8_COMPUTED_GOTO
+#if defined(__GNUC__) || defined(__clang__)
+#define CHIP8_COMPUTED_GOTO 1
+#else
+#define CHIP8_COMPUTED_GOTO 0
+#endif
+#endif
+
+// Keeps a cold helper out of an interpreter loop so it doesn't push the loop's locals out of registers
+#if defined(__GNUC__) || defined(__clang__)
+#define CHIP8_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define CHIP8_NOINLINE __declspec(noinline)
+#else
+#define CHIP8_NOINLINE
+#endif
+
+unsigned char chip8_fontset[80] =
+{
+    0xF0, 0x90, 0x90, 0x90, 0xF0, //0
+    0x20, 0x60, 0x20, 0x20, 0x70, //1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, //2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0, //3
+    0x90, 0x90, 0xF0, 0x10, 0x10, //4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, //5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, //6
+    0xF0, 0x10, 0x20, 0x40, 0x40, //7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, //8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, //9
+    0xF0, 0x90, 0xF0, 0x90, 0x90, //A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, //B
+    0xF0, 0x80, 0x80, 0x80, 0xF0, //C
+    0xE0, 0x90, 0x90, 0x90, 0xE0, //D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, //E
+    0xF0, 0x80, 0xF0, 0x80, 0x80  //F
+};
+
+const char *engine_names[ENGINE_COUNT] = {
+    "switch",
+    "batch",
+    "table",
+    "threaded",
+    "predecoded",
+    "fused",
+    "jit",
+    "trace",
+    "aot",
+    "opcode"
+};
+
+const char *op_names[OP_COUNT] = {
+    "INVALID",
+    "00E0",
+    "00EE",
+    "1NNN",
+    "2NNN",
+    "3XNN",
+    "4XNN",
+    "5XY0",
+    "6XNN",
+    "7XNN",
+    "8XY0",
+    "8XY1",
+    "8XY2",
+    "8XY3",
+    "8XY4",
+    "8XY5",
+    "8XY6",
+    "8XY7",
+    "8XYE",
+    "9XY0",
+    "ANNN",
+    "BNNN",
+    "CXNN",
+    "DXYN",
+    "EX9E",
+    "EXA1",
+    "FX07",
+    "FX0A",
+    "FX15",
+    "FX18",
+    "FX1E",
+    "FX29",
+    "FX33",
+    "FX55",
+    "FX65"
+};
+
+const char *platform_names[PLATFORM_COUNT] = {
+    "vip",
+    "chip48",
+    "schip",
+    "xochip"
+};
+
+#define QUIRK_FLAGS(policy) {policy::shift_vy, policy::load_store_i, policy::jump_vx, policy::vf_reset}
+
+const QuirkFlags platform_quirks[PLATFORM_COUNT] = {
+    QUIRK_FLAGS(QuirksVIP),
+    QUIRK_FLAGS(QuirksCHIP48),
+    QUIRK_FLAGS(QuirksSCHIP),
+    QUIRK_FLAGS(QuirksXOCHIP)
+};
+
+#undef QUIRK_FLAGS
+
+const char *run_result_names[RUN_RESULT_COUNT] = {
+    "cycles exhausted",
+    "breakpoint",
+    "waiting for key",
+    "illegal opcode"
+};
+
+static void op_predecode(CHIP_8 &c, const Instruction &ins);
+#if CHIP8_OPCODE_TABLE
+static void build_opcode_handlers();
+#endif
+
+unsigned char op_table[16 * 256];
+
+void build_op_table()
+{
+    for (int hi = 0; hi < 16; hi++)
+    {
+        for (int lo = 0; lo < 256; lo++)
+        {
+            unsigned char op = OP_INVALID;
+            switch (hi)
+            {
+            case 0x0:
+                if ((lo & 0xF) == 0x0)
+                    op = OP_00E0;
+                else if ((lo & 0xF) == 0xE)
+                    op = OP_00EE;
+                break;
+            case 0x1: op = OP_1NNN; break;
+            case 0x2: op = OP_2NNN; break;
+            case 0x3: op = OP_3XNN; break;
+            case 0x4: op = OP_4XNN; break;
+            case 0x5: op = OP_5XY0; break;
+            case 0x6: op = OP_6XNN; break;
+            case 0x7: op = OP_7XNN; break;
+            case 0x8:
+                switch (lo & 0xF)
+                {
+                case 0x0: op = OP_8XY0; break;
+                case 0x1: op = OP_8XY1; break;
+                case 0x2: op = OP_8XY2; break;
+                case 0x3: op = OP_8XY3; break;
+                case 0x4: op = OP_8XY4; break;
+                case 0x5: op = OP_8XY5; break;
+                case 0x6: op = OP_8XY6; break;
+                case 0x7: op = OP_8XY7; break;
+                case 0xE: op = OP_8XYE; break;
+                }
+                break;
+            case 0x9: op = OP_9XY0; break;
+            case 0xA: op = OP_ANNN; break;
+            case 0xB: op = OP_BNNN; break;
+            case 0xC: op = OP_CXNN; break;
+            case 0xD: op = OP_DXYN; break;
+            case 0xE:
+                if ((lo & 0xF) == 0xE)
+                    op = OP_EX9E;
+                else if ((lo & 0xF) == 0x1)
+                    op = OP_EXA1;
+                break;
+            case 0xF:
+                switch (lo)
+                {
+                case 0x07: op = OP_FX07; break;
+                case 0x0A: op = OP_FX0A; break;
+                case 0x15: op = OP_FX15; break;
+                case 0x18: op = OP_FX18; break;
+                case 0x1E: op = OP_FX1E; break;
+                case 0x29: op = OP_FX29; break;
+                case 0x33: op = OP_FX33; break;
+                case 0x55: op = OP_FX55; break;
+                case 0x65: op = OP_FX65; break;
+                }
+                break;
+            }
+            op_table[hi << 8 | lo] = op;
+        }
+    }
+
+#if CHIP8_OPCODE_TABLE
+    build_opcode_handlers();
+#endif
+}
+
+// The table engine handlers, each one mirrors its case in CHIP_8::tick()
+static void op_invalid(CHIP_8 &, const Instruction &) {}
+static void op_00E0(CHIP_8 &c, const Instruction &) { c.clear_display(); c.pc += 2; }
+static void op_00EE(CHIP_8 &c, const Instruction &) { c.pc = c.stack[(--c.sp) & 0xF] + 2; }
+static void op_1NNN(CHIP_8 &c, const Instruction &ins) { c.pc = ins.nnn; }
+static void op_2NNN(CHIP_8 &c, const Instruction &ins) { c.stack[(c.sp++) & 0xF] = c.pc; c.pc = ins.nnn; }
+static void op_3XNN(CHIP_8 &c, const Instruction &ins) { c.pc += c.V[ins.x] == ins.nn ? 4 : 2; }
+static void op_4XNN(CHIP_8 &c, const Instruction &ins) { c.pc += c.V[ins.x] != ins.nn ? 4 : 2; }
+static void op_5XY0(CHIP_8 &c, const Instruction &ins) { c.pc += c.V[ins.x] == c.V[ins.y] ? 4 : 2; }
+static void op_6XNN(CHIP_8 &c, const Instruction &ins) { c.V[ins.x] = ins.nn; c.pc += 2; }
+static void op_7XNN(CHIP_8 &c, const Instruction &ins) { c.V[ins.x] += ins.nn; c.pc += 2; }
+static void op_8XY0(CHIP_8 &c, const Instruction &ins) { c.V[ins.x] = c.V[ins.y]; c.pc += 2; }
+
+template <class Q>
+static void op_8XY1(CHIP_8 &c, const Instruction &ins)
+{
+    c.V[ins.x] |= c.V[ins.y];
+    if (Q::vf_reset)
+        c.V[0xF] = 0;
+    c.pc += 2;
+}
+
+template <class Q>
+static void op_8XY2(CHIP_8 &c, const Instruction &ins)
+{
+    c.V[ins.x] &= c.V[ins.y];
+    if (Q::vf_reset)
+        c.V[0xF] = 0;
+    c.pc += 2;
+}
+
+template <class Q>
+static void op_8XY3(CHIP_8 &c, const Instruction &ins)
+{
+    c.V[ins.x] ^= c.V[ins.y];
+    if (Q::vf_reset)
+        c.V[0xF] = 0;
+    c.pc += 2;
+}
+
+static void op_8XY4(CHIP_8 &c, const Instruction &ins)
+{
+    c.V[0xF] = (int)c.V[ins.x] + (int)c.V[ins.y] >= 256;
+    c.V[ins.x] += c.V[ins.y];
+    c.pc += 2;
+}
+
+static void op_8XY5(CHIP_8 &c, const Instruction &ins)
+{
+    c.V[0xF] = c.V[ins.x] >= c.V[ins.y];
+    c.V[ins.x] -= c.V[ins.y];
+    c.pc += 2;
+}
+
+template <class Q>
+static void op_8XY6(CHIP_8 &c, const Instruction &ins)
+{
+    unsigned char source = c.V[Q::shift_vy ? ins.y : ins.x];
+    c.V[ins.x] = source >> 1;
+    c.V[0xF] = source & 1;
+    c.pc += 2;
+}
+
+static void op_8XY7(CHIP_8 &c, const Instruction &ins)
+{
+    c.V[0xF] = c.V[ins.x] > c.V[ins.y];
+    c.V[ins.x] = c.V[ins.y] - c.V[ins.x];
+    c.pc += 2;
+}
+
+template <class Q>
+static void op_8XYE(CHIP_8 &c, const Instruction &ins)
+{
+    unsigned char source = c.V[Q::shift_vy ? ins.y : ins.x];
+    c.V[ins.x] = source << 1;
+    c.V[0xF] = source >> 7;
+    c.pc += 2;
+}
+
+static void op_9XY0(CHIP_8 &c, const Instruction &ins) { c.pc += c.V[ins.x] != c.V[ins.y] ? 4 : 2; }
+static void op_ANNN(CHIP_8 &c, const Instruction &ins) { c.I = ins.nnn; c.pc += 2; }
+template <class Q>
+static void op_BNNN(CHIP_8 &c, const Instruction &ins) { c.pc = ins.nnn + c.V[Q::jump_vx ? ins.x : 0]; }
+
+static void op_CXNN(CHIP_8 &c, const Instruction &ins) { c.V[ins.x] = c.random() & ins.nn; c.pc += 2; }
+static void op_DXYN(CHIP_8 &c, const Instruction &ins) { c.draw_sprite(c.V[ins.x], c.V[ins.y], ins.n); c.pc += 2; }
+static void op_EX9E(CHIP_8 &c, const Instruction &ins) { c.pc += c.key_down(c.V[ins.x]) ? 4 : 2; }
+static void op_EXA1(CHIP_8 &c, const Instruction &ins) { c.pc += !c.key_down(c.V[ins.x]) ? 4 : 2; }
+static void op_FX07(CHIP_8 &c, const Instruction &ins) { c.V[ins.x] = c.delay(); c.pc += 2; }
+static void op_FX0A(CHIP_8 &c, const Instruction &ins) { c.wait_key(ins.x); }
+static void op_FX15(CHIP_8 &c, const Instruction &ins) { c.set_delay(c.V[ins.x]); c.pc += 2; }
+static void op_FX18(CHIP_8 &c, const Instruction &ins) { c.set_sound(c.V[ins.x]); c.pc += 2; }
+static void op_FX1E(CHIP_8 &c, const Instruction &ins) { c.I += c.V[ins.x]; c.pc += 2; }
+static void op_FX29(CHIP_8 &c, const Instruction &ins) { c.I = c.V[ins.x] * 5; c.pc += 2; }
+
+static void op_FX33(CHIP_8 &c, const Instruction &ins) { c.store_bcd(ins.x); c.pc += 2; }
+
+template <class Q>
+static void op_FX55(CHIP_8 &c, const Instruction &ins)
+{
+    c.store_registers(ins.x);
+    c.I += load_store_advance(Q::load_store_i, ins.x);
+    c.pc += 2;
+}
+
+template <class Q>
+static void op_FX65(CHIP_8 &c, const Instruction &ins)
+{
+    for (int i = 0; i <= ins.x; i++)
+        c.V[i] = c.memory[(c.I + i) & 0xFFF];
+    c.I += load_store_advance(Q::load_store_i, ins.x);
+    c.pc += 2;
+}
+
+// One handler table per platform, only the quirk handlers differ
+template <class Q>
+struct Handlers
+{
+    static const Handler table[OP_COUNT];
+};
+
+template <class Q>
+const Handler Handlers<Q>::table[OP_COUNT] = {
+    op_invalid,
+    op_00E0,
+    op_00EE,
+    op_1NNN,
+    op_2NNN,
+    op_3XNN,
+    op_4XNN,
+    op_5XY0,
+    op_6XNN,
+    op_7XNN,
+    op_8XY0,
+    op_8XY1<Q>,
+    op_8XY2<Q>,
+    op_8XY3<Q>,
+    op_8XY4,
+    op_8XY5,
+    op_8XY6<Q>,
+    op_8XY7,
+    op_8XYE<Q>,
+    op_9XY0,
+    op_ANNN,
+    op_BNNN<Q>,
+    op_CXNN,
+    op_DXYN,
+    op_EX9E,
+    op_EXA1,
+    op_FX07,
+    op_FX0A,
+    op_FX15,
+    op_FX18,
+    op_FX1E,
+    op_FX29,
+    op_FX33,
+    op_FX55<Q>,
+    op_FX65<Q>
+};
+
+static const Handler *const op_handlers[PLATFORM_COUNT] = {
+    Handlers<QuirksVIP>::table,
+    Handlers<QuirksCHIP48>::table,
+    Handlers<QuirksSCHIP>::table,
+    Handlers<QuirksXOCHIP>::table
+};
+
+#if CHIP8_OPCODE_TABLE
+// The opcode engine, one handler per 16 bit opcode with the operands as template constants so
+// dispatch is a single indexed call and nothing is decoded at run time. Only the 8XYN, BNNN and
+// FXNN pages hold quirks, the other platforms share the VIP handlers for the rest
+
+// build_op_table() as a constant expression, the two have to agree
+static constexpr int family_8(int n)
+{
+    return n <= 0x7 ? OP_8XY0 + n : n == 0xE ? OP_8XYE : OP_INVALID;
+}
+
+static constexpr int family_f(int lo)
+{
+    return lo == 0x07 ? OP_FX07 : lo == 0x0A ? OP_FX0A : lo == 0x15 ? OP_FX15 : lo == 0x18 ? OP_FX18 :
+           lo == 0x1E ? OP_FX1E : lo == 0x29 ? OP_FX29 : lo == 0x33 ? OP_FX33 : lo == 0x55 ? OP_FX55 :
+           lo == 0x65 ? OP_FX65 : OP_INVALID;
+}
+
+static constexpr int opcode_op(unsigned opcode)
+{
+    return (opcode >> 12) == 0x0 ? ((opcode & 0xF) == 0x0 ? OP_00E0 : (opcode & 0xF) == 0xE ? OP_00EE : OP_INVALID) :
+           (opcode >> 12) <= 0x7 ? OP_1NNN + (int)(opcode >> 12) - 1 :
+           (opcode >> 12) == 0x8 ? family_8(opcode & 0xF) :
+           (opcode >> 12) <= 0xD ? OP_9XY0 + (int)(opcode >> 12) - 9 :
+           (opcode >> 12) == 0xE ? ((opcode & 0xF) == 0xE ? OP_EX9E : (opcode & 0xF) == 0x1 ? OP_EXA1 : OP_INVALID) :
+           family_f(opcode & 0xFF);
+}
+
+// The handler of an op as a direct call, so it inlines into the opcode handler
+template <int OP, class Q>
+struct OpHandler;
+
+#define OP_HANDLER(name, handler)                                                            \
+    template <class Q>                                                                      \
+    struct OpHandler<OP_##name, Q>                                                          \
+    {                                                                                       \
+        static void call(CHIP_8 &c, const Instruction &ins) { handler(c, ins); }            \
+    };
+
+OP_HANDLER(INVALID, op_invalid)
+OP_HANDLER(00E0, op_00E0)
+OP_HANDLER(00EE, op_00EE)
+OP_HANDLER(1NNN, op_1NNN)
+OP_HANDLER(2NNN, op_2NNN)
+OP_HANDLER(3XNN, op_3XNN)
+OP_HANDLER(4XNN, op_4XNN)
+OP_HANDLER(5XY0, op_5XY0)
+OP_HANDLER(6XNN, op_6XNN)
+OP_HANDLER(7XNN, op_7XNN)
+OP_HANDLER(8XY0, op_8XY0)
+OP_HANDLER(8XY1, op_8XY1<Q>)
+OP_HANDLER(8XY2, op_8XY2<Q>)
+OP_HANDLER(8XY3, op_8XY3<Q>)
+OP_HANDLER(8XY4, op_8XY4)
+OP_HANDLER(8XY5, op_8XY5)
+OP_HANDLER(8XY6, op_8XY6<Q>)
+OP_HANDLER(8XY7, op_8XY7)
+OP_HANDLER(8XYE, op_8XYE<Q>)
+OP_HANDLER(9XY0, op_9XY0)
+OP_HANDLER(ANNN, op_ANNN)
+OP_HANDLER(BNNN, op_BNNN<Q>)
+OP_HANDLER(CXNN, op_CXNN)
+OP_HANDLER(DXYN, op_DXYN)
+OP_HANDLER(EX9E, op_EX9E)
+OP_HANDLER(EXA1, op_EXA1)
+OP_HANDLER(FX07, op_FX07)
+OP_HANDLER(FX0A, op_FX0A)
+OP_HANDLER(FX15, op_FX15)
+OP_HANDLER(FX18, op_FX18)
+OP_HANDLER(FX1E, op_FX1E)
+OP_HANDLER(FX29, op_FX29)
+OP_HANDLER(FX33, op_FX33)
+OP_HANDLER(FX55, op_FX55<Q>)
+OP_HANDLER(FX65, op_FX65<Q>)
+
+#undef OP_HANDLER
+
+typedef void (*OpcodeHandler)(CHIP_8 &c);
+
+template <unsigned OPCODE, class Q>
+static void op_exact(CHIP_8 &c)
+{
+    const Instruction ins = {NULL, OPCODE, OPCODE & 0x0FFF, opcode_op(OPCODE), (OPCODE >> 8) & 0xF,
+                             (OPCODE >> 4) & 0xF, OPCODE & 0xF, OPCODE & 0xFF, 0};
+    OpHandler<opcode_op(OPCODE), Q>::call(c, ins);
+}
+
+// Fills [BASE, BASE + COUNT) by halving, 16 at a time at the bottom to keep the recursion shallow
+template <class Q, unsigned BASE, unsigned COUNT>
+struct FillOpcodes
+{
+    static void fill(OpcodeHandler *table)
+    {
+        FillOpcodes<Q, BASE, COUNT / 2>::fill(table);
+        FillOpcodes<Q, BASE + COUNT / 2, COUNT / 2>::fill(table);
+    }
+};
+
+template <class Q, unsigned BASE>
+struct FillOpcodes<Q, BASE, 16>
+{
+    static void fill(OpcodeHandler *table)
+    {
+        static const OpcodeHandler handlers[16] = {
+            op_exact<BASE + 0x0, Q>, op_exact<BASE + 0x1, Q>, op_exact<BASE + 0x2, Q>, op_exact<BASE + 0x3, Q>,
+            op_exact<BASE + 0x4, Q>, op_exact<BASE + 0x5, Q>, op_exact<BASE + 0x6, Q>, op_exact<BASE + 0x7, Q>,
+            op_exact<BASE + 0x8, Q>, op_exact<BASE + 0x9, Q>, op_exact<BASE + 0xA, Q>, op_exact<BASE + 0xB, Q>,
+            op_exact<BASE + 0xC, Q>, op_exact<BASE + 0xD, Q>, op_exact<BASE + 0xE, Q>, op_exact<BASE + 0xF, Q>
+        };
+        memcpy(table + BASE, handlers, sizeof(handlers));
+    }
+};
+
+static OpcodeHandler opcode_handlers[PLATFORM_COUNT][0x10000];
+
+template <class Q>
+static void build_quirk_pages(OpcodeHandler *table)
+{
+    memcpy(table, opcode_handlers[PLATFORM_VIP], sizeof(opcode_handlers[PLATFORM_VIP]));
+    FillOpcodes<Q, 0x8000, 0x1000>::fill(table);
+    FillOpcodes<Q, 0xB000, 0x1000>::fill(table);
+    FillOpcodes<Q, 0xF000, 0x1000>::fill(table);
+}
+
+static void build_opcode_handlers()
+{
+    FillOpcodes<QuirksVIP, 0x0000, 0x10000>::fill(opcode_handlers[PLATFORM_VIP]);
+    build_quirk_pages<QuirksCHIP48>(opcode_handlers[PLATFORM_CHIP48]);
+    build_quirk_pages<QuirksSCHIP>(opcode_handlers[PLATFORM_SCHIP]);
+    build_quirk_pages<QuirksXOCHIP>(opcode_handlers[PLATFORM_XOCHIP]);
+}
+#endif
+
+// Superinstructions, one handler for a run of two or three instructions at consecutive addresses.
+// The set comes from chip8-pairs over roms/, plus the 6XNN 6XNN, 7XNN 3XNN 1NNN and skip 1NNN idioms.
+// A handler stops as soon as an instruction doesn't fall through, so it returns how many it ran.
+// Nothing that stores to memory is fused, a store could rewrite the rest of the run
+typedef int (*FusedHandler)(CHIP_8 &c, const Instruction *ins);
+
+template <Handler A, Handler B>
+static int fused(CHIP_8 &c, const Instruction *ins)
+{
+    unsigned short next = c.pc + 2;
+    A(c, ins[0]);
+    c.cycle++;
+    if (c.pc != next)
+        return 1;
+    B(c, ins[2]);
+    c.cycle++;
+    return 2;
+}
+
+template <Handler A, Handler B, Handler C>
+static int fused(CHIP_8 &c, const Instruction *ins)
+{
+    unsigned short next = c.pc + 2;
+    A(c, ins[0]);
+    c.cycle++;
+    if (c.pc != next)
+        return 1;
+    B(c, ins[2]);
+    c.cycle++;
+    if (c.pc != next + 2)
+        return 2;
+    C(c, ins[4]);
+    c.cycle++;
+    return 3;
+}
+
+struct Superinstruction
+{
+    unsigned char ops[3];
+    unsigned char length;
+    FusedHandler handler;
+};
+
+#define SUPERINSTRUCTION_COUNT 17
+
+// Entry 0 means not fused, triples come first so the longest match wins. Like the handlers
+// there is one table per platform, the ops and their order are the same in all of them
+template <class Q>
+struct Superinstructions
+{
+    static const Superinstruction table[SUPERINSTRUCTION_COUNT];
+};
+
+template <class Q>
+const Superinstruction Superinstructions<Q>::table[SUPERINSTRUCTION_COUNT] = {
+    {{OP_INVALID}, 0, NULL},
+    {{OP_6XNN, OP_8XY2, OP_DXYN}, 3, fused<op_6XNN, op_8XY2<Q>, op_DXYN>},
+    {{OP_DXYN, OP_6XNN, OP_EXA1}, 3, fused<op_DXYN, op_6XNN, op_EXA1>},
+    {{OP_ANNN, OP_DXYN, OP_DXYN}, 3, fused<op_ANNN, op_DXYN, op_DXYN>},
+    {{OP_8XY4, OP_8XY4, OP_6XNN}, 3, fused<op_8XY4, op_8XY4, op_6XNN>},
+    {{OP_7XNN, OP_3XNN, OP_1NNN}, 3, fused<op_7XNN, op_3XNN, op_1NNN>},
+    {{OP_8XY5, OP_3XNN, OP_1NNN}, 3, fused<op_8XY5, op_3XNN, op_1NNN>},
+    {{OP_6XNN, OP_EXA1}, 2, fused<op_6XNN, op_EXA1>},
+    {{OP_6XNN, OP_8XY2}, 2, fused<op_6XNN, op_8XY2<Q> >},
+    {{OP_ANNN, OP_DXYN}, 2, fused<op_ANNN, op_DXYN>},
+    {{OP_DXYN, OP_6XNN}, 2, fused<op_DXYN, op_6XNN>},
+    {{OP_8XY2, OP_DXYN}, 2, fused<op_8XY2<Q>, op_DXYN>},
+    {{OP_8XY2, OP_4XNN}, 2, fused<op_8XY2<Q>, op_4XNN>},
+    {{OP_6XNN, OP_6XNN}, 2, fused<op_6XNN, op_6XNN>},
+    {{OP_7XNN, OP_4XNN}, 2, fused<op_7XNN, op_4XNN>},
+    {{OP_3XNN, OP_1NNN}, 2, fused<op_3XNN, op_1NNN>},
+    {{OP_4XNN, OP_1NNN}, 2, fused<op_4XNN, op_1NNN>}
+};
+
+static const Superinstruction *const superinstructions[PLATFORM_COUNT] = {
+    Superinstructions<QuirksVIP>::table,
+    Superinstructions<QuirksCHIP48>::table,
+    Superinstructions<QuirksSCHIP>::table,
+    Superinstructions<QuirksXOCHIP>::table
+};
+
+void CHIP_8::predecode_at(int addr)
+{
+    Instruction &entry = decoded[addr & 0xFFF];
+    entry = decode(fetch(addr));
+    entry.handler = op_handlers[platform][entry.op];
+}
+
+// Turns the whole address space into micro-ops, run after the rom or font is loaded
+void CHIP_8::predecode()
+{
+    for (int addr = 0; addr < 4 * 1024; addr++)
+        predecode_at(addr);
+    fuse();
+    if (jit)
+        jit->flush();
+    aot = aot_find(*this);
+}
+
+// Picks the superinstruction starting at addr, every entry it covers must be pre-decoded
+void CHIP_8::fuse_at(int addr)
+{
+    Instruction &entry = decoded[addr & 0xFFF];
+    entry.fused = 0;
+    for (int s = 1; s < SUPERINSTRUCTION_COUNT; s++)
+    {
+        const Superinstruction &candidate = superinstructions[platform][s];
+        if (addr + candidate.length * 2 > 4 * 1024)
+            continue;
+
+        bool match = true;
+        for (int k = 0; k < candidate.length && match; k++)
+            match = decoded[addr + k * 2].op == candidate.ops[k];
+        if (match)
+        {
+            entry.fused = s;
+            return;
+        }
+    }
+}
+
+// Superinstruction pass over the pre-decoded program, only the fused engine uses the result
+void CHIP_8::fuse()
+{
+    for (int addr = 0; addr < 4 * 1024; addr++)
+        fuse_at(addr);
+}
+
+void CHIP_8::invalidate(int addr, int length)
+{
+    for (int a = addr - 1; a < addr + length; a++)
+        decoded[a & 0xFFF].handler = op_predecode;
+    // A triple spans 6 bytes, runs that reach into the store aren't fused again until the next predecode()
+    for (int a = addr - 5; a < addr + length; a++)
+        decoded[a & 0xFFF].fused = 0;
+    if (jit)
+        jit->invalidate(addr, length);
+    if (aot && !aot_intact(*aot, *this, addr, length))
+        aot = NULL;
+}
+
+// Decodes a stale entry in place and runs it
+static void op_predecode(CHIP_8 &c, const Instruction &)
+{
+    c.predecode_at(c.pc);
+    const Instruction &entry = c.decoded[c.pc & 0xFFF];
+    entry.handler(c, entry);
+}
+
+void CHIP_8::tick_table()
+{
+    opcode = fetch(pc);
+    Instruction ins = decode(opcode);
+    op_handlers[platform][ins.op](*this, ins);
+    cycle++;
+}
+
+// Runs straight from the pre-decoded micro-ops, nothing is fetched or decoded unless an entry went stale
+void CHIP_8::run_predecoded(int cycles)
+{
+    const Instruction *ins = &decoded[pc & 0xFFF];
+    for (; cycles > 0; cycles--)
+    {
+        ins = &decoded[pc & 0xFFF];
+        ins->handler(*this, *ins);
+        cycle++;
+    }
+    opcode = ins->opcode;
+}
+
+#if CHIP8_OPCODE_TABLE
+// Fetches every instruction like tick() but dispatches on the whole opcode
+void CHIP_8::run_opcode_table(int cycles)
+{
+    OpcodeHandler *table = opcode_handlers[platform];
+    for (; cycles > 0; cycles--)
+    {
+        opcode = fetch(pc);
+        table[opcode](*this);
+        cycle++;
+    }
+}
+#endif
+
+// The predecoded engine with superinstructions, a fused run is only taken when the budget covers all of it
+void CHIP_8::run_fused(int cycles)
+{
+    const Superinstruction *table = superinstructions[platform];
+    const Instruction *ins = &decoded[pc & 0xFFF];
+    while (cycles > 0)
+    {
+        ins = &decoded[pc & 0xFFF];
+        const Superinstruction &run = table[ins->fused];
+        if (ins->fused && run.length <= cycles)
+        {
+            int ran = run.handler(*this, ins);
+            cycles -= ran;
+            ins += (ran - 1) * 2;
+        }
+        else
+        {
+            ins->handler(*this, *ins);
+            cycle++;
+            cycles--;
+        }
+    }
+    opcode = ins->opcode;
+}
+
+// Direct-threaded interpreter: every handler ends in its own indirect jump so the
+// branch predictor can learn opcode pairs. Same semantics as CHIP_8::tick()
+void CHIP_8::run_threaded(int cycles)
+{
+    QUIRKS_DISPATCH(platform, run_threaded_as<Q>(cycles));
+}
+
+template <class Q>
+void CHIP_8::run_threaded_as(int cycles)
+{
+    if (cycles <= 0)
+        return;
+
+#if CHIP8_COMPUTED_GOTO
+    static void *const labels[OP_COUNT] = {
+        &&L_INVALID,
+        &&L_00E0,
+        &&L_00EE,
+        &&L_1NNN,
+        &&L_2NNN,
+        &&L_3XNN,
+        &&L_4XNN,
+        &&L_5XY0,
+        &&L_6XNN,
+        &&L_7XNN,
+        &&L_8XY0,
+        &&L_8XY1,
+        &&L_8XY2,
+        &&L_8XY3,
+        &&L_8XY4,
+        &&L_8XY5,
+        &&L_8XY6,
+        &&L_8XY7,
+        &&L_8XYE,
+        &&L_9XY0,
+        &&L_ANNN,
+        &&L_BNNN,
+        &&L_CXNN,
+        &&L_DXYN,
+        &&L_EX9E,
+        &&L_EXA1,
+        &&L_FX07,
+        &&L_FX0A,
+        &&L_FX15,
+        &&L_FX18,
+        &&L_FX1E,
+        &&L_FX29,
+        &&L_FX33,
+        &&L_FX55,
+        &&L_FX65
+    };
+
+#define HANDLER(name) L_##name:
+#define DISPATCH()                                  \
+    opcode = fetch(pc);                             \
+    goto *labels[op_table[(opcode >> 4 & 0x0F00) | (opcode & 0x00FF)]]
+#define NEXT()              \
+    cycle++;                \
+    if (--cycles == 0)      \
+        return;             \
+    DISPATCH()
+
+    DISPATCH();
+#else
+#define HANDLER(name) case OP_##name:
+#define NEXT()     \
+    cycle++;       \
+    continue
+
+    for (; cycles > 0; cycles--)
+    {
+        opcode = fetch(pc);
+        switch (op_table[(opcode >> 4 & 0x0F00) | (opcode & 0x00FF)])
+        {
+#endif
+
+    HANDLER(INVALID)
+        NEXT();
+
+    HANDLER(00E0)
+        clear_display();
+        pc += 2;
+        NEXT();
+
+    HANDLER(00EE)
+        pc = stack[(--sp) & 0xF] + 2;
+        NEXT();
+
+    HANDLER(1NNN)
+        pc = opcode & 0x0FFF;
+        NEXT();
+
+    HANDLER(2NNN)
+        stack[(sp++) & 0xF] = pc;
+        pc = opcode & 0x0FFF;
+        NEXT();
+
+    HANDLER(3XNN)
+        pc += VX == (opcode & 0x00FF) ? 4 : 2;
+        NEXT();
+
+    HANDLER(4XNN)
+        pc += VX != (opcode & 0x00FF) ? 4 : 2;
+        NEXT();
+
+    HANDLER(5XY0)
+        pc += VX == VY ? 4 : 2;
+        NEXT();
+
+    HANDLER(6XNN)
+        VX = opcode & 0x00FF;
+        pc += 2;
+        NEXT();
+
+    HANDLER(7XNN)
+        VX += opcode & 0x00FF;
+        pc += 2;
+        NEXT();
+
+    HANDLER(8XY0)
+        VX = VY;
+        pc += 2;
+        NEXT();
+
+    HANDLER(8XY1)
+        VX |= VY;
+        if (Q::vf_reset)
+            V[0xF] = 0;
+        pc += 2;
+        NEXT();
+
+    HANDLER(8XY2)
+        VX &= VY;
+        if (Q::vf_reset)
+            V[0xF] = 0;
+        pc += 2;
+        NEXT();
+
+    HANDLER(8XY3)
+        VX ^= VY;
+        if (Q::vf_reset)
+            V[0xF] = 0;
+        pc += 2;
+        NEXT();
+
+    HANDLER(8XY4)
+        V[0xF] = (int)VX + (int)VY >= 256;
+        VX += VY;
+        pc += 2;
+        NEXT();
+
+    HANDLER(8XY5)
+        V[0xF] = VX >= VY;
+        VX -= VY;
+        pc += 2;
+        NEXT();
+
+    HANDLER(8XY6)
+    {
+        unsigned char source = Q::shift_vy ? VY : VX;
+        VX = source >> 1;
+        V[0xF] = source & 1;
+        pc += 2;
+        NEXT();
+    }
+
+    HANDLER(8XY7)
+        V[0xF] = VX > VY;
+        VX = VY - VX;
+        pc += 2;
+        NEXT();
+
+    HANDLER(8XYE)
+    {
+        unsigned char source = Q::shift_vy ? VY : VX;
+        VX = source << 1;
+        V[0xF] = source >> 7;
+        pc += 2;
+        NEXT();
+    }
+
+    HANDLER(9XY0)
+        pc += VX != VY ? 4 : 2;
+        NEXT();
+
+    HANDLER(ANNN)
+        I = opcode & 0x0FFF;
+        pc += 2;
+        NEXT();
+
+    HANDLER(BNNN)
+        pc = (opcode & 0x0FFF) + (Q::jump_vx ? VX : V[0]);
+        NEXT();
+
+    HANDLER(CXNN)
+        VX = random() & (opcode & 0x00FF);
+        pc += 2;
+        NEXT();
+
+    HANDLER(DXYN)
+        draw_sprite(VX, VY, opcode & 0x000F);
+        pc += 2;
+        NEXT();
+
+    HANDLER(EX9E)
+        pc += key_down(VX) ? 4 : 2;
+        NEXT();
+
+    HANDLER(EXA1)
+        pc += !key_down(VX) ? 4 : 2;
+        NEXT();
+
+    HANDLER(FX07)
+        VX = delay();
+        pc += 2;
+        NEXT();
+
+    HANDLER(FX0A)
+        wait_key((opcode & 0x0F00) >> 8);
+        NEXT();
+
+    HANDLER(FX15)
+        set_delay(VX);
+        pc += 2;
+        NEXT();
+
+    HANDLER(FX18)
+        set_sound(VX);
+        pc += 2;
+        NEXT();
+
+    HANDLER(FX1E)
+        I += VX;
+        pc += 2;
+        NEXT();
+
+    HANDLER(FX29)
+        I = VX * 5;
+        pc += 2;
+        NEXT();
+
+    HANDLER(FX33)
+        store_bcd((opcode & 0x0F00) >> 8);
+        pc += 2;
+        NEXT();
+
+    HANDLER(FX55)
+        store_registers((opcode & 0x0F00) >> 8);
+        I += load_store_advance(Q::load_store_i, (opcode & 0x0F00) >> 8);
+        pc += 2;
+        NEXT();
+
+    HANDLER(FX65)
+        for (int i = 0; i <= ((opcode & 0x0F00) >> 8); i++)
+            V[i] = memory[(I + i) & 0xFFF];
+        I += load_store_advance(Q::load_store_i, (opcode & 0x0F00) >> 8);
+        pc += 2;
+        NEXT();
+
+#if !CHIP8_COMPUTED_GOTO
+        }
+    }
+#endif
+
+#undef HANDLER
+#undef DISPATCH
+#undef NEXT
+}
+
+// DXYN for CHIP_8::run(), returns the new VF
+CHIP8_NOINLINE static unsigned char run_draw(CHIP_8 &c, unsigned short I, int vx, int vy, int n, unsigned char vf)
+{
+    c.I = I;
+    c.V[0xF] = vf;
+    c.draw_sprite(vx, vy, n);
+    return c.V[0xF];
+}
+
+// Recognises a loop at pc that only waits for a timer or for input and settles up to cycles
+// worth of it at once, leaving exactly the state running it would have. Keys only change between
+// calls, so the loops that wait on input spin for the whole budget. Returns the cycles accounted
+// for, 0 when pc isn't idle, and sets result for the ones run() reports. Breakpoints could sit
+// inside the loop, so nothing is skipped while any are set
+//
+//   1NNN to itself             forever
+//   illegal opcode             forever, pc never moves
+//   FX0A without a key         forever
+//   EX9E/EXA1; 1NNN to pc      while the key stays up/down
+//   FX07; 3X00; 1NNN to pc     until the delay timer reaches 0
+int CHIP_8::skip_idle(int cycles, RunResult &result)
+{
+    if (cycles <= 0 || breakpoint_count > 0 || pc > 0xFFA)
+        return 0;
+
+    unsigned short first = fetch(pc);
+    unsigned short second = fetch(pc + 2);
+    unsigned short third = fetch(pc + 4);
+    unsigned short back = 0x1000 | pc;
+    int x = (first & 0x0F00) >> 8;
+    int loop = 0;
+    int skipped = 0;
+
+    switch (decode(first).op)
+    {
+    case OP_INVALID:
+        result = RUN_ILLEGAL_OPCODE;
+        loop = 1;
+        skipped = cycles;
+        break;
+    case OP_1NNN:
+        if (first == back)
+        {
+            loop = 1;
+            skipped = cycles;
+        }
+        break;
+    case OP_FX0A:
+        for (int k = 0; k < 16; k++)
+            if (key_down(k))
+                return 0;
+        result = RUN_WAITING_FOR_KEY;
+        loop = 1;
+        skipped = cycles;
+        break;
+    case OP_EX9E:
+    case OP_EXA1:
+        if (second == back && key_down(V[x]) == (decode(first).op == OP_EXA1))
+        {
+            loop = 2;
+            skipped = cycles / 2 * 2;
+        }
+        break;
+    case OP_FX07:
+        if (second == (0x3000 | x << 8) && third == back && delay() > 0)
+        {
+            // Iterations whose FX07 still reads a non-zero value, the last read lands on or
+            // before the final cycle of the tick that takes the timer to 1
+            unsigned long long last = tick_cycle(tick_at(cycle) + delay()) - 1;
+            unsigned long long iterations = (last - cycle) / 3 + 1;
+            if (iterations > (unsigned long long)cycles / 3)
+                iterations = cycles / 3;
+            if (iterations == 0)
+                break;
+            loop = 3;
+            skipped = (int)iterations * 3;
+            // V[x] holds what the last of them read
+            cycle += skipped - 3;
+            V[x] = delay();
+            cycle -= skipped - 3;
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (skipped == 0)
+        return 0;
+
+    opcode = loop == 1 ? first : loop == 2 ? second : third;
+    cycle += skipped;
+    idle_skipped += skipped;
+    return skipped;
+}
+
+// Batch interpreter, same semantics as CHIP_8::tick() but pc, I, sp and V live in locals and
+// CHIP_8 is only written back on exit and around the helpers that read it.
+// The first instruction is never checked for a breakpoint so a stopped run can continue.
+// Keys only change between calls, so an FX0A without a key or an illegal opcode would spin for
+// the rest of the budget, the cycle count is advanced by that much at once and run() returns
+RunResult CHIP_8::run(int cycles)
+{
+    QUIRKS_DISPATCH(platform, return run_as<Q>(cycles));
+    return RUN_CYCLES_EXHAUSTED;
+}
+
+template <class Q>
+RunResult CHIP_8::run_as(int cycles)
+{
+    unsigned short pc = this->pc;
+    unsigned short I = this->I;
+    unsigned short sp = this->sp;
+    unsigned short opcode = this->opcode;
+    unsigned long long start = cycle;
+    int done = 0;
+    unsigned char v[16];
+    memcpy(v, V, 16);
+
+    bool check_breakpoints = breakpoint_count > 0;
+    RunResult result = RUN_CYCLES_EXHAUSTED;
+
+    for (; done < cycles; done++)
+    {
+        if (check_breakpoints && done > 0 && breakpoints[pc & 0xFFF])
+        {
+            result = RUN_BREAKPOINT;
+            break;
+        }
+
+        opcode = fetch(pc);
+        int x = (opcode & 0x0F00) >> 8;
+        int y = (opcode & 0x00F0) >> 4;
+        int nn = opcode & 0x00FF;
+        int nnn = opcode & 0x0FFF;
+
+        switch (op_table[(opcode >> 4 & 0x0F00) | nn])
+        {
+        case OP_00E0:
+            clear_display();
+            pc += 2;
+            break;
+        case OP_00EE:
+            pc = stack[(--sp) & 0xF] + 2;
+            break;
+        case OP_1NNN:
+            // A jump at most two instructions back may close an idle loop
+            if ((unsigned)(pc - nnn) <= 4 && !check_breakpoints)
+            {
+                this->pc = nnn;
+                this->opcode = opcode;
+                cycle = start + done + 1;
+                memcpy(V, v, 16);
+                done += skip_idle(cycles - done - 1, result);
+                opcode = this->opcode;
+                memcpy(v, V, 16);
+            }
+            pc = nnn;
+            break;
+        case OP_2NNN:
+            stack[(sp++) & 0xF] = pc;
+            pc = nnn;
+            break;
+        case OP_3XNN:
+            pc += v[x] == nn ? 4 : 2;
+            break;
+        case OP_4XNN:
+            pc += v[x] != nn ? 4 : 2;
+            break;
+        case OP_5XY0:
+            pc += v[x] == v[y] ? 4 : 2;
+            break;
+        case OP_6XNN:
+            v[x] = nn;
+            pc += 2;
+            break;
+        case OP_7XNN:
+            v[x] += nn;
+            pc += 2;
+            break;
+        case OP_8XY0:
+            v[x] = v[y];
+            pc += 2;
+            break;
+        case OP_8XY1:
+            v[x] |= v[y];
+            if (Q::vf_reset)
+                v[0xF] = 0;
+            pc += 2;
+            break;
+        case OP_8XY2:
+            v[x] &= v[y];
+            if (Q::vf_reset)
+                v[0xF] = 0;
+            pc += 2;
+            break;
+        case OP_8XY3:
+            v[x] ^= v[y];
+            if (Q::vf_reset)
+                v[0xF] = 0;
+            pc += 2;
+            break;
+        case OP_8XY4:
+            v[0xF] = v[x] + v[y] > 255;
+            v[x] += v[y];
+            pc += 2;
+            break;
+        case OP_8XY5:
+            v[0xF] = v[x] >= v[y];
+            v[x] -= v[y];
+            pc += 2;
+            break;
+        case OP_8XY6:
+        {
+            unsigned char source = v[Q::shift_vy ? y : x];
+            v[x] = source >> 1;
+            v[0xF] = source & 1;
+            pc += 2;
+            break;
+        }
+        case OP_8XY7:
+            v[0xF] = v[x] > v[y];
+            v[x] = v[y] - v[x];
+            pc += 2;
+            break;
+        case OP_8XYE:
+        {
+            unsigned char source = v[Q::shift_vy ? y : x];
+            v[x] = source << 1;
+            v[0xF] = source >> 7;
+            pc += 2;
+            break;
+        }
+        case OP_9XY0:
+            pc += v[x] != v[y] ? 4 : 2;
+            break;
+        case OP_ANNN:
+            I = nnn;
+            pc += 2;
+            break;
+        case OP_BNNN:
+            pc = nnn + v[Q::jump_vx ? x : 0];
+            break;
+        case OP_CXNN:
+            v[x] = random() & nn;
+            pc += 2;
+            break;
+        case OP_DXYN:
+            v[0xF] = run_draw(*this, I, v[x], v[y], opcode & 0x000F, v[0xF]);
+            pc += 2;
+            break;
+        case OP_EX9E:
+            pc += key_down(v[x]) ? 4 : 2;
+            break;
+        case OP_EXA1:
+            pc += !key_down(v[x]) ? 4 : 2;
+            break;
+        case OP_FX07:
+            cycle = start + done;
+            v[x] = delay();
+            pc += 2;
+            break;
+        case OP_FX0A:
+            this->pc = pc;
+            V[x] = v[x];
+            wait_key(x);
+            v[x] = V[x];
+            if (this->pc == pc)
+                result = RUN_WAITING_FOR_KEY;
+            pc = this->pc;
+            break;
+        case OP_FX15:
+            cycle = start + done;
+            set_delay(v[x]);
+            pc += 2;
+            break;
+        case OP_FX18:
+            cycle = start + done;
+            set_sound(v[x]);
+            pc += 2;
+            break;
+        case OP_FX1E:
+            I += v[x];
+            pc += 2;
+            break;
+        case OP_FX29:
+            I = v[x] * 5;
+            pc += 2;
+            break;
+        case OP_FX33:
+            this->I = I;
+            V[x] = v[x];
+            store_bcd(x);
+            pc += 2;
+            break;
+        case OP_FX55:
+            this->I = I;
+            memcpy(V, v, x + 1);
+            store_registers(x);
+            I += load_store_advance(Q::load_store_i, x);
+            pc += 2;
+            break;
+        case OP_FX65:
+            for (int i = 0; i <= x; i++)
+                v[i] = memory[(I + i) & 0xFFF];
+            I += load_store_advance(Q::load_store_i, x);
+            pc += 2;
+            break;
+        default:
+            result = RUN_ILLEGAL_OPCODE;
+            break;
+        }
+
+        if (result != RUN_CYCLES_EXHAUSTED)
+        {
+            done = cycles;
+            break;
+        }
+    }
+
+    this->pc = pc;
+    this->I = I;
+    this->sp = sp;
+    this->opcode = opcode;
+    cycle = start + done;
+    memcpy(V, v, 16);
+    return result;
+}
+
+unsigned long long chip8_clock()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Runs slices of RUN_SLICE cycles until chip8_clock() reaches the deadline or run() stops early
+RunResult CHIP_8::run_until(unsigned long long deadline)
+{
+    while (chip8_clock() < deadline)
+    {
+        RunResult result = run(RUN_SLICE);
+        if (result != RUN_CYCLES_EXHAUSTED)
+            return result;
+    }
+    return RUN_CYCLES_EXHAUSTED;
+}
+
+RunResult CHIP_8::execute(Engine engine, int cycles)
+{
+    // Every engine gets idle loops it starts in settled here, run() also catches the ones it jumps into
+    RunResult idle = RUN_CYCLES_EXHAUSTED;
+    cycles -= skip_idle(cycles, idle);
+    if (idle != RUN_CYCLES_EXHAUSTED || cycles == 0)
+        return idle;
+
+    switch (engine)
+    {
+    case ENGINE_SWITCH:
+        QUIRKS_DISPATCH(platform, for (int i = 0; i < cycles; i++) tick_as<Q>());
+        break;
+    case ENGINE_BATCH:
+        return run(cycles);
+    case ENGINE_TABLE:
+        for (int i = 0; i < cycles; i++)
+            tick_table();
+        break;
+    case ENGINE_THREADED:
+        run_threaded(cycles);
+        break;
+    case ENGINE_PREDECODED:
+        run_predecoded(cycles);
+        break;
+    case ENGINE_FUSED:
+        run_fused(cycles);
+        break;
+    case ENGINE_JIT:
+        if (jit)
+            jit->run(*this, cycles);
+        else
+            run_predecoded(cycles);
+        break;
+    case ENGINE_TRACE:
+        if (jit)
+            jit->run_traced(*this, cycles);
+        else
+            run_predecoded(cycles);
+        break;
+    case ENGINE_AOT:
+        if (aot)
+            cycles = aot->run(*this, cycles);
+        if (cycles > 0)
+            run_predecoded(cycles);
+        break;
+    case ENGINE_OPCODE:
+#if CHIP8_OPCODE_TABLE
+        run_opcode_table(cycles);
+#else
+        QUIRKS_DISPATCH(platform, for (int i = 0; i < cycles; i++) tick_as<Q>());
+#endif
+        break;
+    default:
+        break;
+    }
+    return RUN_CYCLES_EXHAUSTED;
+}
+
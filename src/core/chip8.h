@@ -0,0 +1,734 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "quirks.h"
+#include "frontend.h"
+
+#define VX V[(opcode & 0x0F00) >> 8]
+#define VY V[(opcode & 0x00F0) >> 4]
+
+extern unsigned char chip8_fontset[80];
+
+// Every instruction the core understands, named after its opcode pattern
+enum Op
+{
+    OP_INVALID,
+    OP_00E0,
+    OP_00EE,
+    OP_1NNN,
+    OP_2NNN,
+    OP_3XNN,
+    OP_4XNN,
+    OP_5XY0,
+    OP_6XNN,
+    OP_7XNN,
+    OP_8XY0,
+    OP_8XY1,
+    OP_8XY2,
+    OP_8XY3,
+    OP_8XY4,
+    OP_8XY5,
+    OP_8XY6,
+    OP_8XY7,
+    OP_8XYE,
+    OP_9XY0,
+    OP_ANNN,
+    OP_BNNN,
+    OP_CXNN,
+    OP_DXYN,
+    OP_EX9E,
+    OP_EXA1,
+    OP_FX07,
+    OP_FX0A,
+    OP_FX15,
+    OP_FX18,
+    OP_FX1E,
+    OP_FX29,
+    OP_FX33,
+    OP_FX55,
+    OP_FX65,
+    OP_COUNT
+};
+
+extern const char *op_names[OP_COUNT];
+
+struct CHIP_8;
+struct Instruction;
+
+typedef void (*Handler)(CHIP_8 &chip, const Instruction &ins);
+
+// An opcode with its operands extracted once, the handler is only filled in for pre-decoded entries
+struct Instruction
+{
+    Handler handler;
+    unsigned short opcode;
+    unsigned short nnn;
+    unsigned char op;
+    unsigned char x;
+    unsigned char y;
+    unsigned char n;
+    unsigned char nn;
+    // Superinstruction starting here for the fused engine, 0 if none
+    unsigned char fused;
+};
+
+// The interpreter engines selectable at startup
+enum Engine
+{
+    ENGINE_SWITCH,
+    ENGINE_BATCH,
+    ENGINE_TABLE,
+    ENGINE_THREADED,
+    ENGINE_PREDECODED,
+    ENGINE_FUSED,
+    ENGINE_JIT,
+    ENGINE_TRACE,
+    ENGINE_AOT,
+    ENGINE_OPCODE,
+    ENGINE_COUNT
+};
+
+// The opcode engine is a 65536 entry handler table, it adds a lot of build time and code so it
+// is only built with CHIP8_OPCODE_TABLE=1 (premake --opcode-table), otherwise it runs tick()
+#ifndef CHIP8_OPCODE_TABLE
+#define CHIP8_OPCODE_TABLE 0
+#endif
+
+extern const char *engine_names[ENGINE_COUNT];
+
+// Why CHIP_8::run() returned. Only the batch engine stops early, the others always run all cycles
+enum RunResult
+{
+    RUN_CYCLES_EXHAUSTED,
+    RUN_BREAKPOINT,
+    RUN_WAITING_FOR_KEY,
+    RUN_ILLEGAL_OPCODE,
+    RUN_RESULT_COUNT
+};
+
+extern const char *run_result_names[RUN_RESULT_COUNT];
+
+// Cycles between clock checks in CHIP_8::run_until()
+#define RUN_SLICE 1024
+
+// Monotonic nanoseconds, the clock run_until() deadlines are in
+unsigned long long chip8_clock();
+
+// Instructions per second the timers are paced against until set_speed() is called,
+// the frontend runs 10 instructions per 60 Hz frame
+#define CHIP8_DEFAULT_SPEED 600
+
+// Maps (opcode >> 12, opcode & 0xFF) to an Op, the low byte is enough to tell apart
+// every instruction inside the 0x0, 0x8, 0xE and 0xF families
+extern unsigned char op_table[16 * 256];
+
+void build_op_table();
+
+static inline Instruction decode(unsigned short opcode)
+{
+    Instruction ins;
+    ins.opcode = opcode;
+    ins.nnn = opcode & 0x0FFF;
+    ins.op = op_table[(opcode >> 4 & 0x0F00) | (opcode & 0x00FF)];
+    ins.x = (opcode & 0x0F00) >> 8;
+    ins.y = (opcode & 0x00F0) >> 4;
+    ins.n = opcode & 0x000F;
+    ins.nn = opcode & 0x00FF;
+    ins.fused = 0;
+    return ins;
+}
+
+static inline unsigned long long rotl64(unsigned long long x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline unsigned long long rotr64(unsigned long long x, int k)
+{
+    return (x >> k) | (x << ((64 - k) & 63));
+}
+
+struct JIT_X64;
+struct AotProgram;
+
+struct CHIP_8
+{
+    unsigned char memory[4 * 1024];
+    // One row per word, pixel x of a row is bit 63 - x so a row reads left to right in hex
+    unsigned long long display[32];
+    // Bit y is set when row y changed since the last present(), so the frontend can skip the rest
+    unsigned int dirty_rows;
+    // Keys held down, 1 for down, refreshed from input by poll_input()
+    unsigned char key[16];
+
+    unsigned short pc;
+    unsigned short opcode;
+    unsigned short I;
+    unsigned short sp;
+
+    unsigned char V[16];
+
+    unsigned short stack[16];
+
+    // The timers count down at 60 Hz of emulated time, not per instruction. The engines only
+    // advance cycle, delay_timer and sound_timer hold the values at timer_base and drop by one
+    // at every 60 Hz boundary after it, tick k starts at cycle tick_cycle(k). Use delay() and
+    // sound() to read them
+    unsigned char delay_timer;
+    unsigned char sound_timer;
+    unsigned long long cycle;
+    unsigned long long timer_base;
+    // Emulated instructions per second
+    unsigned int speed;
+
+    // Set by loadfile(), see quirks.h
+    Platform platform;
+
+    // CXNN's generator, xoshiro256** seeded from rng_seed by restart(). It is part of the
+    // machine state, so a run replays exactly and separate machines never share it
+    unsigned long long rng_seed;
+    unsigned long long rng_state[4];
+    // Bytes generated ahead in bulk, random() hands them out from random_next up
+    unsigned char random_pool[32];
+    unsigned int random_next;
+
+    // Pre-decoded micro-op for every address, stale entries point at op_predecode
+    Instruction decoded[4 * 1024];
+
+    // Set while the JIT engine drives this machine
+    JIT_X64 *jit;
+
+    // The chip8-aot translation of the loaded rom, dropped when the guest writes over its code
+    const AotProgram *aot;
+
+    // Addresses CHIP_8::run() stops at before executing them
+    unsigned char breakpoints[4 * 1024];
+    int breakpoint_count;
+
+    // Instructions skip_idle() accounted for without running them
+    unsigned long long idle_skipped;
+
+    // Supplied by whoever runs the core, see frontend.h. Both optional, a machine without
+    // them runs headless with no keys down
+    Input *input;
+    Frontend *frontend;
+
+    void set_breakpoint(int addr, bool on)
+    {
+        unsigned char &slot = breakpoints[addr & 0xFFF];
+        breakpoint_count += (on ? 1 : 0) - slot;
+        slot = on;
+    }
+
+    void clear_display()
+    {
+        memset(display, 0, sizeof(display));
+        dirty_rows = ~0u;
+    }
+
+    // The 60 Hz tick a cycle falls in, counted from cycle 0. The boundaries are exact at any
+    // speed, not rounded to a whole number of instructions per tick
+    unsigned long long tick_at(unsigned long long at) const
+    {
+        return at * 60 / speed;
+    }
+
+    // First cycle of a tick
+    unsigned long long tick_cycle(unsigned long long tick) const
+    {
+        return (tick * speed + 59) / 60;
+    }
+
+    // First cycle of the next tick, where frame-sliced runs end their slices
+    unsigned long long next_tick_cycle() const
+    {
+        return tick_cycle(tick_at(cycle) + 1);
+    }
+
+    // 60 Hz boundaries crossed since timer_base
+    unsigned long long timer_ticks() const
+    {
+        return tick_at(cycle) - tick_at(timer_base);
+    }
+
+    unsigned char delay() const
+    {
+        unsigned long long ticks = timer_ticks();
+        return delay_timer > ticks ? delay_timer - ticks : 0;
+    }
+
+    unsigned char sound() const
+    {
+        unsigned long long ticks = timer_ticks();
+        return sound_timer > ticks ? sound_timer - ticks : 0;
+    }
+
+    // Brings delay_timer and sound_timer up to the current cycle
+    void sync_timers()
+    {
+        delay_timer = delay();
+        sound_timer = sound();
+        timer_base = cycle;
+    }
+
+    void set_delay(unsigned char value)
+    {
+        sync_timers();
+        delay_timer = value;
+    }
+
+    void set_sound(unsigned char value)
+    {
+        sync_timers();
+        sound_timer = value;
+    }
+
+    // Emulated instructions per second, the timers stay at 60 Hz of emulated time
+    void set_speed(int instructions_per_second)
+    {
+        sync_timers();
+        speed = instructions_per_second > 0 ? instructions_per_second : 1;
+    }
+
+    bool key_down(int k)
+    {
+        return key[k & 0xF] != 0;
+    }
+
+    // Random byte for CXNN, from the machine's own generator so a run replays from rng_seed
+    unsigned char random()
+    {
+        if (random_next == sizeof(random_pool))
+        {
+            random_bytes(random_pool, sizeof(random_pool));
+            random_next = 0;
+        }
+        return random_pool[random_next++];
+    }
+
+    unsigned long long next_random64()
+    {
+        unsigned long long *s = rng_state;
+        unsigned long long result = rotl64(s[1] * 5, 7) * 9;
+        unsigned long long t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl64(s[3], 45);
+        return result;
+    }
+
+    // Fills out with count bytes straight from the generator, 8 per step
+    void random_bytes(unsigned char *out, int count)
+    {
+        while (count > 0)
+        {
+            unsigned long long r = next_random64();
+            for (int i = 0; i < 8 && count > 0; i++, count--, r >>= 8)
+                *out++ = (unsigned char)r;
+        }
+    }
+
+    // Takes effect at once and on every restart(), the state is expanded with splitmix64
+    // so that any seed, 0 included, gives a good one
+    void seed_random(unsigned long long seed)
+    {
+        rng_seed = seed;
+        for (int i = 0; i < 4; i++)
+        {
+            unsigned long long z = (seed += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            rng_state[i] = z ^ (z >> 31);
+        }
+        random_next = sizeof(random_pool);
+    }
+
+    void poll_input()
+    {
+        if (input)
+            input->poll(key);
+    }
+
+    // Hands the frame and the buzzer state to the frontend, once per 60 Hz frame
+    void present()
+    {
+        if (!frontend)
+            return;
+        frontend->draw(display, dirty_rows);
+        frontend->beep(sound() > 0);
+        dirty_rows = 0;
+    }
+
+    bool pixel(int x, int y) const
+    {
+        return display[y & 31] >> (63 - (x & 63)) & 1;
+    }
+
+    // Draw a sprite at (vx, vy) width 8 and height of N pixels, VF is set on collision. The start
+    // wraps around the screen, the sprite itself wraps at the right edge and is clipped at the bottom
+    void draw_sprite(int vx, int vy, int height)
+    {
+        vx &= 63;
+        vy &= 31;
+        if (height > 32 - vy)
+            height = 32 - vy;
+
+        unsigned long long collision = 0;
+        for (int y = 0; y < height; ++y)
+        {
+            unsigned long long bits = rotr64((unsigned long long)memory[(I + y) & 0xFFF] << 56, vx);
+            collision |= display[vy + y] & bits;
+            display[vy + y] ^= bits;
+            dirty_rows |= (unsigned int)(bits != 0) << (vy + y);
+        }
+        V[0xF] = collision != 0;
+    }
+
+    // Drops the pre-decoded entries and compiled code overlapping a store to [addr, addr + length)
+    void invalidate(int addr, int length);
+
+    void predecode_at(int addr);
+    void predecode();
+    void fuse();
+    void fuse_at(int addr);
+
+    // Stores the Binary-coded decimal representation of VX at I, I + 1 and I + 2
+    void store_bcd(int x)
+    {
+        memory[I & 0xFFF] = V[x] / 100;
+        memory[(I + 1) & 0xFFF] = (V[x] / 10) % 10;
+        memory[(I + 2) & 0xFFF] = V[x] % 10;
+        invalidate(I & 0xFFF, 3);
+    }
+
+    // Stores V0 to VX in memory starting at address I. Addresses wrap at 4K, the load/store quirks walk I upwards
+    void store_registers(int x)
+    {
+        for (int i = 0; i <= x; i++)
+            memory[(I + i) & 0xFFF] = V[i];
+        invalidate(I & 0xFFF, x + 1);
+    }
+
+    // A key press is awaited, and then stored in VX
+    void wait_key(int x)
+    {
+        for (int i = 0; i < 0x10; i++)
+            if (key[i])
+            {
+                V[x] = i;
+                pc += 2;
+            }
+    }
+
+    // The opcode at addr. Fetches wrap at 4K like every other access, BNNN can send pc as high as 0x10FE
+    unsigned short fetch(int addr) const
+    {
+        return memory[addr & 0xFFF] << 8 | memory[(addr + 1) & 0xFFF];
+    }
+
+    // Fetches, decodes and executes one instruction with the quirks of the loaded platform
+    void tick()
+    {
+        QUIRKS_DISPATCH(platform, tick_as<Q>());
+    }
+
+    template <class Q>
+    void tick_as()
+    {
+        opcode = fetch(pc);
+
+        switch (opcode & 0xF000)
+        {
+        case 0x0000:
+        {
+            switch (opcode & 0x000F)
+            {
+            case 0x0000: // 00E0 Clear Display
+                clear_display();
+                pc += 2;
+                break;
+            case 0x000E: // 000EE return from sub routine
+                pc = stack[(--sp) & 0xF] + 2;
+                break;
+            }
+        }
+        break;
+
+        case 0x1000: // 1NNN Jump to address NNN
+            pc = opcode & 0x0FFF;
+            break;
+
+        case 0x2000:                  // 2NNN Call subroutine at NNN
+            stack[(sp++) & 0xF] = pc; // push pc onto stack and increment sp
+            pc = opcode & 0x0FFF;
+            break;
+
+        case 0x3000: // 3XNN skip the next instruction if VX == NN
+            if (V[(opcode & 0x0F00) >> 8] == (opcode & 0x00FF))
+                pc += 4;
+            else
+                pc += 2;
+            break;
+
+        case 0x4000: // 4XNN skip the next instruction if VX != NN
+            if (V[(opcode & 0x0F00) >> 8] != (opcode & 0x00FF))
+                pc += 4;
+            else
+                pc += 2;
+            break;
+
+        case 0x5000: // 5XY0 skip the next instruction if VX == VY
+            if (V[(opcode & 0x0F00) >> 8] == V[(opcode & 0x00F0) >> 4])
+                pc += 4;
+            else
+                pc += 2;
+            break;
+
+        case 0x6000: // 6XNN set VX to NN
+            V[(opcode & 0xF00) >> 8] = (opcode & 0x00FF);
+            pc += 2;
+            break;
+
+        case 0x7000: // 7XNN add NN to VX
+            V[(opcode & 0xF00) >> 8] += (opcode & 0x00FF);
+            pc += 2;
+            break;
+
+        case 0x8000:
+            switch (opcode & 0x000F)
+            {
+            case 0x0000: // 8XY0 set VX = VY
+                VX = VY;
+                pc += 2;
+                break;
+            case 0x0001: // 8XY1 set VX = VX | VY
+                VX = VX | VY;
+                if (Q::vf_reset)
+                    V[0xF] = 0;
+                pc += 2;
+                break;
+            case 0x0002: // 8XY2 set VX = VX & VY
+                VX = VX & VY;
+                if (Q::vf_reset)
+                    V[0xF] = 0;
+                pc += 2;
+                break;
+            case 0x0003: // 8XY1 set VX = VX ^ VY
+                VX = VX ^ VY;
+                if (Q::vf_reset)
+                    V[0xF] = 0;
+                pc += 2;
+                break;
+            case 0x0004: // 8XY4 set VX += VY
+                if ((int)VX + (int)VY < 256)
+                    V[0xF] &= 0;
+                else
+                    V[0xF] = 1;
+                VX += VY;
+                pc += 2;
+                break;
+            case 0x0005: // 8XY5 set VX -= VY
+                if ((int)VX - (int)VY >= 0)
+                    V[0xF] = 1;
+                else
+                    V[0xF] &= 0;
+                VX -= VY;
+                pc += 2;
+                break;
+            case 0x0006: // 8XY6 VX = VY >> 1 or VX >>= 1, VF = the bit shifted out
+            {
+                unsigned char source = Q::shift_vy ? VY : VX;
+                VX = source >> 1;
+                V[0xF] = source & 1;
+                pc += 2;
+                break;
+            }
+            case 0x0007: // 8XY7 VX = VY - VX
+                if ((int)VX - (int)VY > 0)
+                    V[0xF] = 1;
+                else
+                    V[0xF] &= 0;
+                VX = VY - VX;
+                pc += 2;
+                break;
+            case 0x000E: // 8XYE VX = VY << 1 or VX <<= 1, VF = the bit shifted out
+            {
+                unsigned char source = Q::shift_vy ? VY : VX;
+                VX = source << 1;
+                V[0xF] = source >> 7;
+                pc += 2;
+                break;
+            }
+            }
+            break;
+
+        case 0x9000: // 9XY0 skip the next instruction if VX != VY
+            if (V[(opcode & 0x0F00) >> 8] != V[(opcode & 0x00F0) >> 4])
+                pc += 4;
+            else
+                pc += 2;
+            break;
+
+        case 0xA000: // ANNN set I to address NNN
+            I = (opcode & 0x0FFF);
+            pc += 2;
+            break;
+
+        case 0xB000: // BNNN jump to address NNN + V0, or BXNN to XNN + VX
+            pc = (opcode & 0x0FFF) + (Q::jump_vx ? VX : V[0]);
+            break;
+
+        case 0xC000: // CXNN sets VX to random number & NN
+            V[(opcode & 0x0F00) >> 8] = random() & (opcode & 0x00FF);
+            pc += 2;
+            break;
+
+        case 0xD000: // DXYN Draw a sprite at (VX, VY) width 8 and height of N pixels
+            draw_sprite(V[(opcode & 0x0F00) >> 8], V[(opcode & 0x00F0) >> 4], opcode & 0x000F);
+            pc += 2;
+            break;
+
+        case 0xE000:
+            switch (opcode & 0x000F)
+            {
+            case 0x000E: // EX9E: Skips the next instruction if the key stored in VX is pressed
+                if (key_down(V[(opcode & 0x0F00) >> 8]))
+                    pc += 4;
+                else
+                    pc += 2;
+                break;
+
+            case 0x0001: // EXA1: Skips the next instruction if the key stored in VX isn't pressed
+                if (!key_down(V[(opcode & 0x0F00) >> 8]))
+                    pc += 4;
+                else
+                    pc += 2;
+                break;
+            }
+            break;
+        case 0xF000:
+            switch (opcode & 0x00FF)
+            {
+            case 0x0007: // FX07: Sets VX to the value of the delay timer
+                V[(opcode & 0x0F00) >> 8] = delay();
+                pc += 2;
+                break;
+
+            case 0x000A: // FX0A: A key press is awaited, and then stored in VX
+                wait_key((opcode & 0x0F00) >> 8);
+                break;
+
+            case 0x0015: // FX15: Sets the delay timer to VX
+                set_delay(V[(opcode & 0x0F00) >> 8]);
+                pc += 2;
+                break;
+
+            case 0x0018: // FX18: Sets the sound timer to VX
+                set_sound(V[(opcode & 0x0F00) >> 8]);
+                pc += 2;
+                break;
+
+            case 0x001E: // FX1E: Adds VX to I
+                I += V[(opcode & 0x0F00) >> 8];
+                pc += 2;
+                break;
+
+            case 0x0029: // FX29: Sets I to the location of the sprite for the character in VX. Characters 0-F (in hexadecimal) are represented by a 4x5 font
+                I = V[(opcode & 0x0F00) >> 8] * 5;
+                pc += 2;
+                break;
+
+            case 0x0033: // FX33: Stores the Binary-coded decimal representation of VX, with the most significant of three digits at the address in I, the middle digit at I plus 1, and the least significant digit at I plus 2
+                store_bcd((opcode & 0x0F00) >> 8);
+                pc += 2;
+                break;
+
+            case 0x0055: // FX55: Stores V0 to VX in memory starting at address I
+                store_registers((opcode & 0x0F00) >> 8);
+                I += load_store_advance(Q::load_store_i, (opcode & 0x0F00) >> 8);
+                pc += 2;
+                break;
+
+            case 0x0065: //FX65: Fills V0 to VX with values from memory starting at address I
+                for (int i = 0; i <= ((opcode & 0x0F00) >> 8); i++)
+                    V[i] = memory[(I + i) & 0xFFF];
+                I += load_store_advance(Q::load_store_i, (opcode & 0x0F00) >> 8);
+                pc += 2;
+                break;
+            }
+            break;
+        }
+
+        cycle++;
+    }
+
+    void tick_table();
+    void run_threaded(int cycles);
+    template <class Q>
+    void run_threaded_as(int cycles);
+    void run_predecoded(int cycles);
+    void run_fused(int cycles);
+#if CHIP8_OPCODE_TABLE
+    void run_opcode_table(int cycles);
+#endif
+
+    int skip_idle(int cycles, RunResult &result);
+    RunResult run(int cycles);
+    template <class Q>
+    RunResult run_as(int cycles);
+    RunResult run_until(unsigned long long deadline);
+
+    RunResult execute(Engine engine, int cycles);
+
+    void restart()
+    {
+        pc = 0x200;
+        I = 0;
+        opcode = 0;
+        sp = 0;
+        // unsigned char memory[4 * 1024];
+        clear_display();
+        memset(key, 0, 16);
+        memset(V, 0, 16);
+        memset(stack, 0, sizeof(unsigned short) * 16);
+        if (speed == 0)
+            speed = CHIP8_DEFAULT_SPEED;
+        cycle = 0;
+        timer_base = 0;
+        idle_skipped = 0;
+        delay_timer = 0;
+        sound_timer = 0;
+        seed_random(rng_seed);
+
+        for (int i = 0; i < 80; ++i)
+        {
+            memory[i] = chip8_fontset[i];
+        }
+        predecode();
+    }
+
+    // The platform picks the quirks every engine runs the rom with. VIP by default, which the
+    // roms in roms/ were written for. Before the quirk presets the emulator always shifted VX in
+    // place, left I alone on FX55/FX65 and VF alone on 8XY1/2/3, as PLATFORM_SCHIP still does
+    bool loadfile(const char *file_path, Platform platform = PLATFORM_VIP)
+    {
+        this->platform = platform;
+        FILE *file = fopen(file_path, "rb");
+        if (!file)
+        {
+            printf("failed to load %s into memory!\n", file_path);
+            return false;
+        }
+
+        fread(memory + 0x200, 1, (4 * 1024) - 0x200, file);
+
+        fclose(file);
+        predecode();
+        return true;
+    }
+};
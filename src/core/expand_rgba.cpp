@@ -0,0 +1,183 @@
+#include "expand_rgba.h"
+#include <string.h>
+
+#if CHIP8_EXPAND_SIMD
+#include <immintrin.h>
+#endif
+
+const char *expand_kernel_names[EXPAND_KERNEL_COUNT] = {
+    "scalar",
+    "sse2",
+    "avx2"
+};
+
+// Every kernel expands a row once and copies it down for the other scale - 1 lines
+static void repeat_rows(unsigned int *line, int scale)
+{
+    int width = 64 * scale;
+    for (int s = 1; s < scale; s++)
+        memcpy(line + s * width, line, width * sizeof(unsigned int));
+}
+
+void expand_rgba_scalar(const unsigned long long *display, int rows, unsigned int *out, int scale, unsigned int off, unsigned int on)
+{
+    for (int y = 0; y < rows; y++)
+    {
+        unsigned int *line = out + y * scale * 64 * scale;
+        unsigned int *dst = line;
+        unsigned long long row = display[y];
+        for (int x = 0; x < 64; x++)
+        {
+            unsigned int colour = row >> (63 - x) & 1 ? on : off;
+            for (int s = 0; s < scale; s++)
+                *dst++ = colour;
+        }
+        repeat_rows(line, scale);
+    }
+}
+
+#if CHIP8_EXPAND_SIMD
+
+// Writes scale copies of the colour in lane 0 of c. The tail is one more store that overlaps
+// the previous one, only a scale of 3 needs single pixels
+static inline unsigned int *fill(unsigned int *dst, __m128i c, int scale)
+{
+    if (scale < 4)
+    {
+        for (int s = 0; s < scale; s++)
+            dst[s] = _mm_cvtsi128_si32(c);
+        return dst + scale;
+    }
+    for (int s = 0; s + 4 <= scale; s += 4)
+        _mm_storeu_si128((__m128i *)(dst + s), c);
+    _mm_storeu_si128((__m128i *)(dst + scale - 4), c);
+    return dst + scale;
+}
+
+// Four pixels in c, each scaled up
+static inline unsigned int *scale_4(unsigned int *dst, __m128i c, int scale)
+{
+    if (scale == 1)
+    {
+        _mm_storeu_si128((__m128i *)dst, c);
+        return dst + 4;
+    }
+    if (scale == 2)
+    {
+        _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi32(c, c));
+        _mm_storeu_si128((__m128i *)(dst + 4), _mm_unpackhi_epi32(c, c));
+        return dst + 8;
+    }
+    dst = fill(dst, _mm_shuffle_epi32(c, 0x00), scale);
+    dst = fill(dst, _mm_shuffle_epi32(c, 0x55), scale);
+    dst = fill(dst, _mm_shuffle_epi32(c, 0xAA), scale);
+    return fill(dst, _mm_shuffle_epi32(c, 0xFF), scale);
+}
+
+// Four pixels at a time, a nibble of the row is broadcast and each lane tests its own bit
+void expand_rgba_sse2(const unsigned long long *display, int rows, unsigned int *out, int scale, unsigned int off, unsigned int on)
+{
+    const __m128i bits = _mm_set_epi32(1, 2, 4, 8);
+    const __m128i dark = _mm_set1_epi32(off);
+    const __m128i flip = _mm_set1_epi32(off ^ on);
+
+    for (int y = 0; y < rows; y++)
+    {
+        unsigned int *line = out + y * scale * 64 * scale;
+        unsigned int *dst = line;
+        unsigned long long row = display[y];
+        for (int x = 0; x < 64; x += 4)
+        {
+            __m128i nibble = _mm_set1_epi32((int)(row >> (60 - x) & 0xF));
+            __m128i lit = _mm_cmpeq_epi32(_mm_and_si128(nibble, bits), bits);
+            dst = scale_4(dst, _mm_xor_si128(dark, _mm_and_si128(lit, flip)), scale);
+        }
+        repeat_rows(line, scale);
+    }
+}
+
+// Same as the SSE2 kernel eight pixels at a time, a byte of the row per step. Past a scale of 2
+// the time goes into the stores, so the halves are scaled up the SSE2 way
+__attribute__((target("avx2"))) void expand_rgba_avx2(const unsigned long long *display, int rows, unsigned int *out, int scale, unsigned int off, unsigned int on)
+{
+    const __m256i bits = _mm256_set_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256i dark = _mm256_set1_epi32(off);
+    const __m256i flip = _mm256_set1_epi32(off ^ on);
+    const __m256i low = _mm256_set_epi32(3, 3, 2, 2, 1, 1, 0, 0);
+    const __m256i high = _mm256_set_epi32(7, 7, 6, 6, 5, 5, 4, 4);
+
+    for (int y = 0; y < rows; y++)
+    {
+        unsigned int *line = out + y * scale * 64 * scale;
+        unsigned int *dst = line;
+        unsigned long long row = display[y];
+        for (int x = 0; x < 64; x += 8)
+        {
+            __m256i byte = _mm256_set1_epi32((int)(row >> (56 - x) & 0xFF));
+            __m256i lit = _mm256_cmpeq_epi32(_mm256_and_si256(byte, bits), bits);
+            __m256i c = _mm256_xor_si256(dark, _mm256_and_si256(lit, flip));
+
+            if (scale == 1)
+            {
+                _mm256_storeu_si256((__m256i *)dst, c);
+                dst += 8;
+            }
+            else if (scale == 2)
+            {
+                _mm256_storeu_si256((__m256i *)dst, _mm256_permutevar8x32_epi32(c, low));
+                _mm256_storeu_si256((__m256i *)(dst + 8), _mm256_permutevar8x32_epi32(c, high));
+                dst += 16;
+            }
+            else
+            {
+                dst = scale_4(dst, _mm256_castsi256_si128(c), scale);
+                dst = scale_4(dst, _mm256_extracti128_si256(c, 1), scale);
+            }
+        }
+        repeat_rows(line, scale);
+    }
+}
+
+#endif
+
+ExpandRgba expand_kernel(ExpandKernel kernel)
+{
+    switch (kernel)
+    {
+#if CHIP8_EXPAND_SIMD
+    case EXPAND_SSE2:
+        return expand_rgba_sse2;
+    case EXPAND_AVX2:
+        return expand_rgba_avx2;
+#endif
+    case EXPAND_SCALAR:
+        return expand_rgba_scalar;
+    default:
+        return NULL;
+    }
+}
+
+bool expand_kernel_supported(ExpandKernel kernel)
+{
+    if (!expand_kernel(kernel))
+        return false;
+#if CHIP8_EXPAND_SIMD
+    // SSE2 is part of x86-64
+    if (kernel == EXPAND_AVX2)
+        return __builtin_cpu_supports("avx2");
+#endif
+    return true;
+}
+
+ExpandKernel expand_best_kernel()
+{
+    static int best = -1;
+    if (best < 0)
+    {
+        best = EXPAND_SCALAR;
+        for (int k = EXPAND_KERNEL_COUNT - 1; k > EXPAND_SCALAR && best == EXPAND_SCALAR; k--)
+            if (expand_kernel_supported((ExpandKernel)k))
+                best = k;
+    }
+    return (ExpandKernel)best;
+}
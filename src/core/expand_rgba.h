@@ -0,0 +1,42 @@
+#pragma once
+
+// Turns rows of the packed display (see CHIP_8::display) into RGBA32 for a texture. out is
+// (64 * scale) x (rows * scale) pixels with rows tightly packed, lit pixels become on and dark
+// ones off. The colours are written as is, in the byte order the texture expects
+
+typedef void (*ExpandRgba)(const unsigned long long *display, int rows, unsigned int *out, int scale, unsigned int off, unsigned int on);
+
+// The SIMD kernels need x86-64 and GCC/Clang's per-function target attributes, everything
+// else only gets the scalar one
+#ifndef CHIP8_EXPAND_SIMD
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define CHIP8_EXPAND_SIMD 1
+#else
+#define CHIP8_EXPAND_SIMD 0
+#endif
+#endif
+
+enum ExpandKernel
+{
+    EXPAND_SCALAR,
+    EXPAND_SSE2,
+    EXPAND_AVX2,
+    EXPAND_KERNEL_COUNT
+};
+
+extern const char *expand_kernel_names[EXPAND_KERNEL_COUNT];
+
+void expand_rgba_scalar(const unsigned long long *display, int rows, unsigned int *out, int scale, unsigned int off, unsigned int on);
+#if CHIP8_EXPAND_SIMD
+void expand_rgba_sse2(const unsigned long long *display, int rows, unsigned int *out, int scale, unsigned int off, unsigned int on);
+void expand_rgba_avx2(const unsigned long long *display, int rows, unsigned int *out, int scale, unsigned int off, unsigned int on);
+#endif
+
+// NULL for kernels that weren't built
+ExpandRgba expand_kernel(ExpandKernel kernel);
+
+// Built and runnable on this CPU
+bool expand_kernel_supported(ExpandKernel kernel);
+
+// The fastest supported kernel, the CPU is only asked once
+ExpandKernel expand_best_kernel();
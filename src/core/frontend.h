@@ -0,0 +1,21 @@
+#pragma once
+
+// What the core needs from the machine it runs on. The core itself never touches SDL, a window
+// or a sound device, the SDL/ImGui frontend and the headless tools each supply their own
+
+// Fills keys[0x0..0xF] with 1 for every key held down right now
+struct Input
+{
+    virtual ~Input() {}
+    virtual void poll(unsigned char keys[16]) = 0;
+};
+
+// Shows frames and drives the buzzer
+struct Frontend
+{
+    virtual ~Frontend() {}
+    // display is 32 rows, pixel x of a row is bit 63 - x. Bit y of dirty_rows is set for every
+    // row that changed since the previous call, 0 when the frame is the same
+    virtual void draw(const unsigned long long *display, unsigned int dirty_rows) = 0;
+    virtual void beep(bool on) = 0;
+};
@@ -0,0 +1,361 @@
+#include "jit_x64.h"
+#include "jit_x64_codegen.h"
+
+// Trace engine, see JIT_X64::run_traced()
+
+// Backward jumps to the same target before it gets recorded
+#define TRACE_HOT_THRESHOLD 16
+// Heads whose recordings keep failing are left to the interpreter
+#define TRACE_MAX_FAILURES 4
+#define MAX_TRACE_BYTES (32 * 1024)
+
+static bool traceable(int op)
+{
+    return op != OP_INVALID && op != OP_FX0A;
+}
+
+static X64Cond invert(X64Cond cc)
+{
+    return (X64Cond)(cc ^ 1);
+}
+
+static void count(X64Emitter &e, unsigned long long *counter)
+{
+    e.mov_r64_imm(RAX, (unsigned long long)counter);
+    e.add_m64_imm(RAX, 0, 1);
+}
+
+// A side exit, emitted out of line after the trace body
+struct TraceStub
+{
+    size_t branch; // rel32 of the jcc that leads here
+    int pc;        // constant next pc, -1 when it is in EDX
+    int executed;
+    int ticks;
+    unsigned short opcode;
+};
+
+// The trampolines live at the start of the buffer, enter saves the callee-saved registers
+// and jumps to the trace, leave restores them and returns the budget left in R15
+void JIT_X64::emit_trampolines()
+{
+    if (!buffer)
+        return;
+
+    BlockCompiler bc;
+    bc.e.init(buffer, buffer_size);
+
+    enter = (JitEnter)bc.e.here();
+    bc.prologue();
+    bc.e.mov_r32_r32(R15, RDX);
+    bc.e.jmp_r64(RSI);
+
+    leave = bc.e.here();
+    bc.e.mov_r32_r32(RAX, R15);
+    bc.epilogue();
+
+    used = (bc.e.size + 15) & ~(size_t)15;
+}
+
+void JIT_X64::reset_traces()
+{
+    memset(trace_at, 0, sizeof(trace_at));
+    memset(hot, 0, sizeof(hot));
+    trace_count = 0;
+    exit_count = 0;
+    recording = false;
+    record_length = 0;
+}
+
+void JIT_X64::link(const JitTraceExit &exit)
+{
+    int index = trace_at[exit.target];
+    X64Emitter::patch_rel32(exit.jump, index ? traces[index - 1].entry : leave);
+}
+
+// Called when the guest writes over a trace, the code stays in the buffer until the next flush
+void JIT_X64::kill_trace(int index)
+{
+    JitTrace &trace = traces[index];
+    trace.alive = 0;
+    if (trace_at[trace.head] != index + 1)
+        return;
+
+    trace_at[trace.head] = 0;
+    for (int i = 0; i < exit_count; i++)
+        if (exits[i].target == trace.head)
+            link(exits[i]);
+}
+
+void JIT_X64::abandon_trace(int head)
+{
+    if (trace_failures[head] < 255)
+        trace_failures[head]++;
+    stats.traces_aborted++;
+}
+
+// Compiles the recording, the trace loops back to its head when end_pc is the head and
+// otherwise ends in an exit to end_pc
+void JIT_X64::compile_trace(CHIP_8 &chip, int end_pc)
+{
+    int head = record[0].pc;
+    int length = record_length;
+
+    // The guest may have written over the path after it was recorded
+    for (int i = 0; i < length; i++)
+    {
+        int pc = record[i].pc;
+        if ((chip.memory[pc] << 8 | chip.memory[pc + 1]) != record[i].opcode)
+        {
+            abandon_trace(head);
+            return;
+        }
+    }
+
+    if (trace_count == MAX_TRACES || exit_count + length + 1 > MAX_TRACE_EXITS || buffer_size - used < MAX_TRACE_BYTES)
+        flush();
+
+    Instruction ins[MAX_TRACE_LENGTH];
+    for (int i = 0; i < length; i++)
+        ins[i] = decode(record[i].opcode);
+
+    JitTrace &trace = traces[trace_count];
+
+    BlockCompiler bc;
+    bc.e.init(buffer + used, MAX_TRACE_BYTES);
+    bc.trace_mode = true;
+    bc.pending_ticks = 0;
+    bc.quirks = platform_quirks[chip.platform];
+    // R15 holds the budget
+    bc.allocate(ins, length, host_pool_size - 1);
+
+    TraceStub stubs[MAX_TRACE_LENGTH];
+    int stub_count = 0;
+    size_t exit_jumps[MAX_TRACE_LENGTH + 1];
+    unsigned short exit_targets[MAX_TRACE_LENGTH + 1];
+    int exit_jump_count = 0;
+
+    // A trace only runs when the budget covers all of it
+    const unsigned char *entry = bc.e.here();
+    bc.e.alu_r32_imm(ALU_CMP, R15, length);
+    bc.e.jcc_rel32(CC_L, leave);
+    count(bc.e, &stats.trace_entries);
+    bc.reload();
+    size_t loop = bc.e.size;
+
+    for (int i = 0; i < length; i++)
+    {
+        const Instruction &in = ins[i];
+        int pc = record[i].pc;
+        int next = record[i].next;
+
+        bool guard = false;
+        X64Cond exit_cc = CC_NE;
+        int exit_pc = -1;
+        X64Cond cc;
+
+        switch (in.op)
+        {
+        case OP_1NNN:
+            break;
+        case OP_2NNN:
+            bc.stack_push(pc);
+            break;
+        case OP_3XNN:
+        case OP_4XNN:
+        case OP_5XY0:
+        case OP_9XY0:
+        case OP_EX9E:
+        case OP_EXA1:
+            if (in.op == OP_EX9E || in.op == OP_EXA1)
+            {
+                bc.call((const void *)jit_key_down, in.x);
+                bc.e.test_r32_r32(RAX, RAX);
+                cc = in.op == OP_EX9E ? CC_NE : CC_E;
+            }
+            else
+                cc = bc.compare(in);
+            // Leave when the skip goes the other way than while recording
+            guard = true;
+            exit_cc = next == pc + 4 ? invert(cc) : cc;
+            exit_pc = next == pc + 4 ? pc + 2 : pc + 4;
+            break;
+        case OP_00EE:
+        case OP_BNNN:
+            if (in.op == OP_00EE)
+                bc.stack_pop();
+            else
+                bc.computed_jump(in);
+            bc.e.alu_r32_imm(ALU_CMP, RDX, next);
+            guard = true;
+            break;
+        default:
+            bc.emit_straight(in);
+            break;
+        }
+        bc.pending_ticks++;
+
+        // The store may have hit the trace itself
+        if (in.op == OP_FX33 || in.op == OP_FX55)
+        {
+            bc.e.mov_r64_imm(RAX, (unsigned long long)&trace.alive);
+            bc.e.cmp_m8_imm(RAX, 0, 0);
+            guard = true;
+            exit_cc = CC_E;
+            exit_pc = pc + 2;
+        }
+
+        if (guard)
+        {
+            TraceStub &stub = stubs[stub_count++];
+            stub.branch = bc.e.jcc_rel32(exit_cc, bc.e.here());
+            stub.pc = exit_pc;
+            stub.executed = i + 1;
+            stub.ticks = bc.pending_ticks;
+            stub.opcode = record[i].opcode;
+        }
+    }
+
+    unsigned short last_opcode = record[length - 1].opcode;
+    if (end_pc == head)
+    {
+        // Registers stay in host registers around the loop, only the cycle count is synced
+        bc.sync_cycle();
+        bc.e.alu_r32_imm(ALU_SUB, R15, length);
+        bc.e.alu_r32_imm(ALU_CMP, R15, length);
+        bc.e.jcc_rel32(CC_GE, bc.e.code + loop);
+        bc.write_back(head, last_opcode);
+        bc.e.jmp_rel32(leave);
+    }
+    else
+    {
+        bc.write_back(end_pc, last_opcode);
+        bc.e.alu_r32_imm(ALU_SUB, R15, length);
+        exit_targets[exit_jump_count] = end_pc;
+        exit_jumps[exit_jump_count++] = bc.e.jmp_rel32(leave);
+    }
+
+    for (int s = 0; s < stub_count; s++)
+    {
+        const TraceStub &stub = stubs[s];
+        if (!bc.e.overflow)
+            X64Emitter::patch_rel32(bc.e.code + stub.branch, bc.e.here());
+        bc.pending_ticks = stub.ticks;
+        bc.write_back(stub.pc, stub.opcode);
+        bc.e.alu_r32_imm(ALU_SUB, R15, stub.executed);
+        count(bc.e, &stats.side_exits);
+        if (stub.pc >= 0)
+        {
+            exit_targets[exit_jump_count] = stub.pc;
+            exit_jumps[exit_jump_count++] = bc.e.jmp_rel32(leave);
+        }
+        else
+            bc.e.jmp_rel32(leave);
+    }
+
+    if (bc.e.overflow)
+    {
+        abandon_trace(head);
+        return;
+    }
+
+    trace.entry = entry;
+    trace.head = head;
+    trace.length = length;
+    trace.alive = 1;
+    for (int i = 0; i < length; i++)
+    {
+        trace.pcs[i] = record[i].pc;
+        covered[record[i].pc] = 1;
+        covered[record[i].pc + 1] = 1;
+    }
+    trace_at[head] = ++trace_count;
+    used += (bc.e.size + 15) & ~(size_t)15;
+    stats.traces_compiled++;
+
+    // Chain the new exits and send everything that left towards this head straight into it
+    for (int i = 0; i < exit_jump_count; i++)
+    {
+        JitTraceExit &exit = exits[exit_count++];
+        exit.jump = bc.e.code + exit_jumps[i];
+        exit.target = exit_targets[i];
+    }
+    for (int i = 0; i < exit_count; i++)
+        link(exits[i]);
+}
+
+// Interprets with CHIP_8::tick() until a backward 1NNN target gets hot, then records the
+// path the guest takes from there until it comes back around, reaches another trace or
+// hits something that can't be traced
+void JIT_X64::run_traced(CHIP_8 &chip, int cycles)
+{
+    while (cycles > 0)
+    {
+        int pc = chip.pc;
+        if (!buffer || pc + 1 >= 4 * 1024)
+        {
+            // A fetch that wraps around the end of memory can't be recorded, and the trace
+            // must not join the steps on either side of it as if they ran back to back
+            if (recording)
+            {
+                recording = false;
+                abandon_trace(record_length > 0 ? record[0].pc : pc & 0xFFF);
+            }
+            chip.tick();
+            cycles--;
+            stats.interpreted_instructions++;
+            continue;
+        }
+
+        unsigned short opcode = chip.memory[pc] << 8 | chip.memory[pc + 1];
+
+        if (recording)
+        {
+            if (record_length == MAX_TRACE_LENGTH || !traceable(decode(opcode).op) ||
+                (record_length > 0 && (pc == record[0].pc || trace_at[pc])))
+            {
+                recording = false;
+                if (record_length > 0)
+                    compile_trace(chip, pc);
+                else
+                    abandon_trace(pc);
+                continue;
+            }
+
+            JitTraceStep &step = record[record_length++];
+            step.pc = pc;
+            step.opcode = opcode;
+            chip.tick();
+            step.next = chip.pc;
+            cycles--;
+            stats.interpreted_instructions++;
+            continue;
+        }
+
+        if (trace_at[pc])
+        {
+            int left = enter(&chip, traces[trace_at[pc] - 1].entry, cycles);
+            stats.trace_runs++;
+            if (left < cycles)
+            {
+                stats.native_instructions += cycles - left;
+                cycles = left;
+                continue;
+            }
+            // Not enough budget left for the whole trace, the interpreter finishes the slice
+        }
+
+        chip.tick();
+        cycles--;
+        stats.interpreted_instructions++;
+
+        int target = opcode & 0xFFF;
+        if ((opcode & 0xF000) == 0x1000 && target <= pc && !trace_at[target] &&
+            trace_failures[target] < TRACE_MAX_FAILURES && ++hot[target] >= TRACE_HOT_THRESHOLD)
+        {
+            hot[target] = 0;
+            recording = true;
+            record_length = 0;
+        }
+    }
+}
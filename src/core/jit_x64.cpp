@@ -0,0 +1,285 @@
+#include "jit_x64.h"
+#include "jit_x64_codegen.h"
+
+// The generated code follows the System V calling convention
+#if defined(__x86_64__) && !defined(_WIN32)
+#define CHIP8_JIT_SUPPORTED 1
+#include <sys/mman.h>
+#else
+#define CHIP8_JIT_SUPPORTED 0
+#endif
+
+#define MAX_BLOCK_LENGTH 64
+#define MAX_BLOCK_BYTES (16 * 1024)
+
+static bool compilable(int op)
+{
+    switch (op)
+    {
+    case OP_INVALID:
+    case OP_EX9E:
+    case OP_EXA1:
+    case OP_FX0A:
+        return false;
+    default:
+        return true;
+    }
+}
+
+// Control flow and stores that may hit code end a block
+static bool ends_block(int op)
+{
+    switch (op)
+    {
+    case OP_00EE:
+    case OP_1NNN:
+    case OP_2NNN:
+    case OP_3XNN:
+    case OP_4XNN:
+    case OP_5XY0:
+    case OP_9XY0:
+    case OP_BNNN:
+    case OP_FX33:
+    case OP_FX55:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Emits one block instruction, returns the constant exit pc, -1 for a pc in EDX, -2 to keep going
+static int emit_block_instruction(BlockCompiler &bc, const Instruction &ins, int pc)
+{
+    int next = -2;
+    switch (ins.op)
+    {
+    case OP_00EE:
+        bc.stack_pop();
+        next = -1;
+        break;
+    case OP_1NNN:
+        next = ins.nnn;
+        break;
+    case OP_2NNN:
+        bc.stack_push(pc);
+        next = ins.nnn;
+        break;
+    case OP_3XNN:
+    case OP_4XNN:
+    case OP_5XY0:
+    case OP_9XY0:
+        bc.skip(bc.compare(ins), pc);
+        next = -1;
+        break;
+    case OP_BNNN:
+        bc.computed_jump(ins);
+        next = -1;
+        break;
+    case OP_FX33:
+    case OP_FX55:
+        bc.emit_straight(ins);
+        next = pc + 2;
+        break;
+    default:
+        bc.emit_straight(ins);
+        break;
+    }
+    bc.pending_ticks++;
+    return next;
+}
+
+bool JIT_X64::init(size_t bytes)
+{
+    buffer = NULL;
+    buffer_size = 0;
+    used = 0;
+    cross_check = false;
+    reference = NULL;
+    memset(&stats, 0, sizeof(stats));
+    memset(blocks, 0, sizeof(blocks));
+    memset(covered, 0, sizeof(covered));
+    memset(trace_failures, 0, sizeof(trace_failures));
+    enter = NULL;
+    leave = NULL;
+    reset_traces();
+
+#if CHIP8_JIT_SUPPORTED
+    void *memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        printf("jit: failed to map %zu bytes of executable memory, using the interpreter\n", bytes);
+        return false;
+    }
+    buffer = (unsigned char *)memory;
+    buffer_size = bytes;
+    emit_trampolines();
+    return true;
+#else
+    printf("jit: unsupported host, using the interpreter\n");
+    return false;
+#endif
+}
+
+void JIT_X64::shutdown()
+{
+#if CHIP8_JIT_SUPPORTED
+    if (buffer)
+        munmap(buffer, buffer_size);
+#endif
+    buffer = NULL;
+    delete reference;
+    reference = NULL;
+}
+
+void JIT_X64::flush()
+{
+    used = 0;
+    memset(blocks, 0, sizeof(blocks));
+    memset(covered, 0, sizeof(covered));
+    reset_traces();
+    emit_trampolines();
+    stats.flushes++;
+}
+
+void JIT_X64::invalidate(int addr, int length)
+{
+    bool hit = false;
+    for (int a = addr; a < addr + length; a++)
+        hit |= covered[a & 0xFFF] != 0;
+    if (!hit)
+        return;
+
+    for (int start = 0; start < 4 * 1024; start++)
+    {
+        JitBlock &block = blocks[start];
+        if (block.state != BLOCK_EMPTY && start < addr + length && block.end > addr)
+            block.state = BLOCK_EMPTY;
+    }
+
+    for (int t = 0; t < trace_count; t++)
+    {
+        const JitTrace &trace = traces[t];
+        for (int i = 0; i < trace.length && trace.alive; i++)
+            if (trace.pcs[i] < addr + length && trace.pcs[i] + 2 > addr)
+                kill_trace(t);
+    }
+}
+
+void JIT_X64::compile(CHIP_8 &chip, int start)
+{
+    JitBlock &block = blocks[start];
+
+    Instruction ins[MAX_BLOCK_LENGTH];
+    int count = 0;
+    int pc = start;
+    while (count < MAX_BLOCK_LENGTH && pc + 1 < 4 * 1024)
+    {
+        Instruction in = decode(chip.memory[pc] << 8 | chip.memory[pc + 1]);
+        if (!compilable(in.op))
+            break;
+        ins[count++] = in;
+        pc += 2;
+        if (ends_block(in.op))
+            break;
+    }
+
+    for (int a = start; a < (count ? pc : start + 2); a++)
+        covered[a & 0xFFF] = 1;
+
+    if (count == 0)
+    {
+        block.state = BLOCK_INTERPRET;
+        block.end = start + 2;
+        return;
+    }
+
+    if (buffer_size - used < MAX_BLOCK_BYTES)
+        flush();
+
+    BlockCompiler bc;
+    bc.e.init(buffer + used, MAX_BLOCK_BYTES);
+    bc.trace_mode = false;
+    bc.pending_ticks = 0;
+    bc.quirks = platform_quirks[chip.platform];
+    bc.allocate(ins, count, host_pool_size);
+    bc.prologue();
+    bc.reload();
+
+    int next = -2;
+    for (int i = 0; i < count && next == -2; i++)
+        next = emit_block_instruction(bc, ins[i], start + i * 2);
+    if (next == -2)
+        next = pc;
+    bc.write_back(next, ins[count - 1].opcode);
+    bc.epilogue();
+
+    if (bc.e.overflow)
+    {
+        block.state = BLOCK_INTERPRET;
+        block.end = start + 2;
+        return;
+    }
+
+    block.code = (JitCode)(buffer + used);
+    block.end = pc;
+    block.length = count;
+    block.state = BLOCK_NATIVE;
+    used += (bc.e.size + 15) & ~(size_t)15;
+    stats.blocks_compiled++;
+}
+
+static bool same_state(const CHIP_8 &a, const CHIP_8 &b)
+{
+    return !memcmp(&a, &b, offsetof(CHIP_8, decoded));
+}
+
+void JIT_X64::run_checked(CHIP_8 &chip, const JitBlock &block)
+{
+    if (!reference)
+        reference = new CHIP_8();
+    *reference = chip;
+    reference->jit = NULL;
+
+    int start = chip.pc;
+    block.code(&chip);
+    for (int i = 0; i < block.length; i++)
+        reference->tick();
+
+    if (!same_state(chip, *reference))
+    {
+        stats.mismatches++;
+        printf("jit: block at %03X diverged from CHIP_8::tick() (pc %03X vs %03X)\n", start, chip.pc, reference->pc);
+        reference->jit = chip.jit;
+        chip = *reference;
+        flush();
+    }
+}
+
+void JIT_X64::run(CHIP_8 &chip, int cycles)
+{
+    while (cycles > 0)
+    {
+        int pc = chip.pc;
+        if (buffer && pc + 1 < 4 * 1024)
+        {
+            if (blocks[pc].state == BLOCK_EMPTY)
+                compile(chip, pc);
+
+            const JitBlock &block = blocks[pc];
+            if (block.state == BLOCK_NATIVE && block.length <= cycles)
+            {
+                if (cross_check)
+                    run_checked(chip, block);
+                else
+                    block.code(&chip);
+                cycles -= block.length;
+                stats.native_instructions += block.length;
+                continue;
+            }
+        }
+
+        chip.tick();
+        cycles--;
+        stats.interpreted_instructions++;
+    }
+}
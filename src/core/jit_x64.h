@@ -0,0 +1,129 @@
+#pragma once
+
+#include "chip8.h"
+
+enum JitBlockState
+{
+    BLOCK_EMPTY,
+    BLOCK_NATIVE,
+    BLOCK_INTERPRET
+};
+
+typedef void (*JitCode)(CHIP_8 *chip);
+
+// A straight-line run of guest instructions starting at one address
+struct JitBlock
+{
+    JitCode code;
+    unsigned short end; // one past the last guest byte
+    unsigned short length;
+    unsigned char state;
+};
+
+#define MAX_TRACE_LENGTH 128
+#define MAX_TRACES 256
+#define MAX_TRACE_EXITS 4096
+
+// Enters trace code with the cycle budget in R15, returns what is left of it
+typedef int (*JitEnter)(CHIP_8 *chip, const unsigned char *code, int budget);
+
+// One instruction the interpreter ran while recording, next is the pc it went on to
+struct JitTraceStep
+{
+    unsigned short pc;
+    unsigned short opcode;
+    unsigned short next;
+};
+
+// A recorded path through hot code, compiled with guards that leave it wherever the
+// guest goes somewhere else than it did while recording
+struct JitTrace
+{
+    const unsigned char *entry;
+    unsigned short pcs[MAX_TRACE_LENGTH];
+    unsigned short head;
+    unsigned short length;
+    unsigned char alive; // cleared when the guest writes over the trace, checked after FX33 and FX55
+};
+
+// A trace exit to a constant pc, its jump goes to the leave trampoline until a trace starts there
+struct JitTraceExit
+{
+    unsigned char *jump; // rel32 field of the jmp
+    unsigned short target;
+};
+
+struct JitStats
+{
+    unsigned long long blocks_compiled;
+    unsigned long long native_instructions;
+    unsigned long long interpreted_instructions;
+    unsigned long long flushes;
+    unsigned long long mismatches;
+
+    unsigned long long traces_compiled;
+    unsigned long long traces_aborted;
+    // Entries into trace code, from the dispatcher or from another trace
+    unsigned long long trace_entries;
+    // Returns to the dispatcher, the difference to trace_entries went trace to trace
+    unsigned long long trace_runs;
+    // Guards that failed, the rest of the returns ran out of budget or reached untraced code
+    unsigned long long side_exits;
+};
+
+// Translates CHIP-8 basic blocks to x86-64. V0-VF and I live in host registers inside
+// a block and CHIP_8 is only written back at the block exit. Anything it can't compile
+// runs through CHIP_8::tick()
+//
+// run_traced() is the trace engine on the same code buffer: backward 1NNN targets that get
+// hot are recorded through CHIP_8::tick(), compiled as one loop and linked to each other
+struct JIT_X64
+{
+    unsigned char *buffer;
+    size_t buffer_size;
+    size_t used;
+
+    JitBlock blocks[4 * 1024];
+    // Set for every guest byte some block was compiled from, so stores to data skip the block scan
+    unsigned char covered[4 * 1024];
+
+    // Runs every block a second time through CHIP_8::tick() and compares the results
+    bool cross_check;
+    CHIP_8 *reference;
+
+    // Trace engine, trace_at holds the trace index + 1 for every head
+    JitEnter enter;
+    unsigned char *leave;
+    unsigned short trace_at[4 * 1024];
+    unsigned short hot[4 * 1024];
+    unsigned char trace_failures[4 * 1024];
+    JitTrace traces[MAX_TRACES];
+    int trace_count;
+    JitTraceExit exits[MAX_TRACE_EXITS];
+    int exit_count;
+
+    bool recording;
+    JitTraceStep record[MAX_TRACE_LENGTH];
+    int record_length;
+
+    JitStats stats;
+
+    bool init(size_t bytes = 4 << 20);
+    void shutdown();
+    bool available() const { return buffer != NULL; }
+
+    void flush();
+    void invalidate(int addr, int length);
+    void run(CHIP_8 &chip, int cycles);
+
+    void compile(CHIP_8 &chip, int start);
+    void run_checked(CHIP_8 &chip, const JitBlock &block);
+
+    void run_traced(CHIP_8 &chip, int cycles);
+    void emit_trampolines();
+    void reset_traces();
+    void compile_trace(CHIP_8 &chip, int end_pc);
+    void abandon_trace(int head);
+    void link(const JitTraceExit &exit);
+    void kill_trace(int index);
+};
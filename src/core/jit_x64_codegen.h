@@ -0,0 +1,435 @@
+#pragma once
+
+// Code generation shared by the basic-block and the trace compiler, only included by the JIT sources
+
+#include "chip8.h"
+#include "x64_emitter.h"
+#include <stddef.h>
+
+// Guest register 16 is I, 0-15 are V0-VF
+#define GUEST_I 16
+#define GUEST_COUNT 17
+
+#define OFF_V ((int)offsetof(CHIP_8, V))
+#define OFF_I ((int)offsetof(CHIP_8, I))
+#define OFF_PC ((int)offsetof(CHIP_8, pc))
+#define OFF_OPCODE ((int)offsetof(CHIP_8, opcode))
+#define OFF_SP ((int)offsetof(CHIP_8, sp))
+#define OFF_STACK ((int)offsetof(CHIP_8, stack))
+#define OFF_CYCLE ((int)offsetof(CHIP_8, cycle))
+
+// Host registers handed out to guest registers, RBX holds the CHIP_8 pointer and
+// RAX, RCX, RDX and RDI are scratch. Traces keep their cycle budget in R15, the last entry
+static const int host_pool[] = {RBP, R12, R13, R14, RSI, R8, R9, R10, R11, R15};
+static const int host_pool_size = sizeof(host_pool) / sizeof(host_pool[0]);
+
+static inline void jit_clear_display(CHIP_8 *c) { c->clear_display(); }
+static inline void jit_random(CHIP_8 *c, int x, int nn) { c->V[x] = c->random() & nn; }
+static inline void jit_draw(CHIP_8 *c, int x, int y, int n) { c->draw_sprite(c->V[x], c->V[y], n); }
+static inline void jit_store_bcd(CHIP_8 *c, int x) { c->store_bcd(x); }
+static inline void jit_store_registers(CHIP_8 *c, int x, int advance)
+{
+    c->store_registers(x);
+    c->I += advance;
+}
+static inline int jit_key_down(CHIP_8 *c, int x) { return c->key_down(c->V[x]); }
+static inline void jit_read_delay(CHIP_8 *c, int x) { c->V[x] = c->delay(); }
+static inline void jit_set_delay(CHIP_8 *c, int x) { c->set_delay(c->V[x]); }
+static inline void jit_set_sound(CHIP_8 *c, int x) { c->set_sound(c->V[x]); }
+
+static inline void jit_load_registers(CHIP_8 *c, int x, int advance)
+{
+    for (int i = 0; i <= x; i++)
+        c->V[i] = c->memory[(c->I + i) & 0xFFF];
+    c->I += advance;
+}
+
+// Counts how often each guest register is touched outside of helper calls
+static inline void count_uses(const Instruction &ins, const QuirkFlags &quirks, int *uses)
+{
+    switch (ins.op)
+    {
+    case OP_3XNN:
+    case OP_4XNN:
+    case OP_6XNN:
+    case OP_7XNN:
+        uses[ins.x]++;
+        break;
+    case OP_5XY0:
+    case OP_9XY0:
+    case OP_8XY0:
+        uses[ins.x]++;
+        uses[ins.y]++;
+        break;
+    case OP_8XY1:
+    case OP_8XY2:
+    case OP_8XY3:
+        uses[ins.x]++;
+        uses[ins.y]++;
+        uses[0xF] += quirks.vf_reset;
+        break;
+    case OP_8XY4:
+    case OP_8XY5:
+    case OP_8XY7:
+        uses[ins.x] += 2;
+        uses[ins.y] += 2;
+        uses[0xF]++;
+        break;
+    case OP_8XY6:
+    case OP_8XYE:
+        uses[quirks.shift_vy ? ins.y : ins.x]++;
+        uses[ins.x]++;
+        uses[0xF]++;
+        break;
+    case OP_ANNN:
+        uses[GUEST_I]++;
+        break;
+    case OP_BNNN:
+        uses[quirks.jump_vx ? ins.x : 0]++;
+        break;
+    case OP_FX1E:
+    case OP_FX29:
+        uses[ins.x]++;
+        uses[GUEST_I]++;
+        break;
+    default:
+        break;
+    }
+}
+
+// Code generation state for one block or trace
+struct BlockCompiler
+{
+    X64Emitter e;
+    int host[GUEST_COUNT];
+    bool dirty[GUEST_COUNT];
+    // Traces loop, so compile-time dirty tracking doesn't hold and every register is written back
+    bool trace_mode;
+    // Instructions that already ran but aren't in CHIP_8::cycle yet, added in one go
+    int pending_ticks;
+    // Quirks of the platform the code is compiled for
+    QuirkFlags quirks;
+
+    void allocate(const Instruction *ins, int count, int pool_size)
+    {
+        int uses[GUEST_COUNT] = {};
+        for (int i = 0; i < count; i++)
+            count_uses(ins[i], quirks, uses);
+
+        for (int g = 0; g < GUEST_COUNT; g++)
+        {
+            host[g] = NO_REG;
+            dirty[g] = false;
+        }
+
+        for (int h = 0; h < pool_size; h++)
+        {
+            int best = -1;
+            for (int g = 0; g < GUEST_COUNT; g++)
+                if (host[g] == NO_REG && uses[g] > 0 && (best < 0 || uses[g] > uses[best]))
+                    best = g;
+            if (best < 0)
+                break;
+            host[best] = host_pool[h];
+        }
+    }
+
+    void load(int g, int scratch)
+    {
+        if (host[g] != NO_REG)
+            e.mov_r32_r32(scratch, host[g]);
+        else if (g == GUEST_I)
+            e.movzx_r32_m16(scratch, RBX, OFF_I);
+        else
+            e.movzx_r32_m8(scratch, RBX, OFF_V + g);
+    }
+
+    // The scratch value must already be zero-extended from 8 bits (16 for I)
+    void store(int g, int scratch)
+    {
+        if (host[g] != NO_REG)
+        {
+            e.mov_r32_r32(host[g], scratch);
+            dirty[g] = true;
+        }
+        else if (g == GUEST_I)
+            e.mov_m16_r16(RBX, OFF_I, scratch);
+        else
+            e.mov_m8_r8(RBX, OFF_V + g, scratch);
+    }
+
+    void flush()
+    {
+        for (int g = 0; g < GUEST_COUNT; g++)
+        {
+            if (host[g] == NO_REG || (!dirty[g] && !trace_mode))
+                continue;
+            if (g == GUEST_I)
+                e.mov_m16_r16(RBX, OFF_I, host[g]);
+            else
+                e.mov_m8_r8(RBX, OFF_V + g, host[g]);
+            dirty[g] = false;
+        }
+    }
+
+    void reload()
+    {
+        for (int g = 0; g < GUEST_COUNT; g++)
+        {
+            if (host[g] == NO_REG)
+                continue;
+            if (g == GUEST_I)
+                e.movzx_r32_m16(host[g], RBX, OFF_I);
+            else
+                e.movzx_r32_m8(host[g], RBX, OFF_V + g);
+        }
+    }
+
+    // The timers are derived from the cycle count, so it has to be current before they are touched
+    void sync_cycle()
+    {
+        if (pending_ticks == 0)
+            return;
+        e.add_m64_imm(RBX, OFF_CYCLE, pending_ticks);
+        pending_ticks = 0;
+    }
+
+    // The helper's int result is left in EAX
+    void call(const void *helper, int a, int b = 0, int c = 0)
+    {
+        flush();
+        e.mov_r64_r64(RDI, RBX);
+        e.mov_r32_imm(RSI, a);
+        e.mov_r32_imm(RDX, b);
+        e.mov_r32_imm(RCX, c);
+        e.call_abs(helper);
+        reload();
+    }
+
+    void prologue()
+    {
+        e.push(RBX);
+        e.push(RBP);
+        e.push(R12);
+        e.push(R13);
+        e.push(R14);
+        e.push(R15);
+        // Keeps the stack 16 byte aligned for helper calls
+        e.alu_r64_imm8(ALU_SUB, RSP, 8);
+        e.mov_r64_r64(RBX, RDI);
+    }
+
+    void epilogue()
+    {
+        e.alu_r64_imm8(ALU_ADD, RSP, 8);
+        e.pop(R15);
+        e.pop(R14);
+        e.pop(R13);
+        e.pop(R12);
+        e.pop(RBP);
+        e.pop(RBX);
+        e.ret();
+    }
+
+    // Writes everything back, pc is either the constant next_pc or already in EDX
+    void write_back(int next_pc, unsigned short last_opcode)
+    {
+        sync_cycle();
+        flush();
+        if (next_pc >= 0)
+            e.mov_m16_imm(RBX, OFF_PC, next_pc);
+        else
+            e.mov_m16_r16(RBX, OFF_PC, RDX);
+        e.mov_m16_imm(RBX, OFF_OPCODE, last_opcode);
+    }
+
+    // Compares the operands of a skip opcode, returns the condition under which it skips
+    X64Cond compare(const Instruction &ins)
+    {
+        load(ins.x, RAX);
+        if (ins.op == OP_3XNN || ins.op == OP_4XNN)
+            e.alu_r32_imm(ALU_CMP, RAX, ins.nn);
+        else
+        {
+            load(ins.y, RCX);
+            e.alu_r32_r32(ALU_CMP, RAX, RCX);
+        }
+        return ins.op == OP_3XNN || ins.op == OP_5XY0 ? CC_E : CC_NE;
+    }
+
+    // EDX = condition ? pc + 4 : pc + 2, flags must already hold the comparison
+    void skip(X64Cond cc, int pc)
+    {
+        e.mov_r32_imm(RDX, pc + 2);
+        e.mov_r32_imm(RCX, pc + 4);
+        e.cmovcc_r32_r32(cc, RDX, RCX);
+    }
+
+    void stack_push(int pc)
+    {
+        e.movzx_r32_m16(RAX, RBX, OFF_SP);
+        e.mov_r32_r32(RCX, RAX);
+        e.alu_r32_imm(ALU_AND, RCX, 0xF);
+        e.mov_m16_imm(RBX, OFF_STACK, pc, RCX, 2);
+        e.alu_r32_imm(ALU_ADD, RAX, 1);
+        e.mov_m16_r16(RBX, OFF_SP, RAX);
+    }
+
+    // Pops the return address, EDX = the instruction after the call
+    void stack_pop()
+    {
+        e.movzx_r32_m16(RAX, RBX, OFF_SP);
+        e.alu_r32_imm(ALU_SUB, RAX, 1);
+        e.mov_m16_r16(RBX, OFF_SP, RAX);
+        e.alu_r32_imm(ALU_AND, RAX, 0xF);
+        e.movzx_r32_m16(RDX, RBX, OFF_STACK, RAX, 2);
+        e.alu_r32_imm(ALU_ADD, RDX, 2);
+        e.movzx_r32_r16(RDX, RDX);
+    }
+
+    // EDX = NNN + V0, or XNN + VX
+    void computed_jump(const Instruction &ins)
+    {
+        load(quirks.jump_vx ? ins.x : 0, RDX);
+        e.alu_r32_imm(ALU_ADD, RDX, ins.nnn);
+    }
+
+    // Emits an instruction that falls through to the next one, returns false for control flow
+    bool emit_straight(const Instruction &ins)
+    {
+        switch (ins.op)
+        {
+        case OP_00E0:
+            call((const void *)jit_clear_display, 0);
+            break;
+        case OP_6XNN:
+            e.mov_r32_imm(RAX, ins.nn);
+            store(ins.x, RAX);
+            break;
+        case OP_7XNN:
+            load(ins.x, RAX);
+            e.alu_r32_imm(ALU_ADD, RAX, ins.nn);
+            e.movzx_r32_r8(RAX, RAX);
+            store(ins.x, RAX);
+            break;
+        case OP_8XY0:
+            load(ins.y, RAX);
+            store(ins.x, RAX);
+            break;
+        case OP_8XY1:
+        case OP_8XY2:
+        case OP_8XY3:
+            load(ins.x, RAX);
+            load(ins.y, RCX);
+            e.alu_r32_r32(ins.op == OP_8XY1 ? ALU_OR : ins.op == OP_8XY2 ? ALU_AND : ALU_XOR, RAX, RCX);
+            store(ins.x, RAX);
+            if (quirks.vf_reset)
+            {
+                e.mov_r32_imm(RAX, 0);
+                store(0xF, RAX);
+            }
+            break;
+        // The flag is written before the result, exactly like CHIP_8::tick(), so X or Y == F behaves the same
+        case OP_8XY4:
+            load(ins.x, RAX);
+            load(ins.y, RCX);
+            e.alu_r32_r32(ALU_ADD, RAX, RCX);
+            e.shr_r32_imm(RAX, 8);
+            store(0xF, RAX);
+            load(ins.x, RAX);
+            load(ins.y, RCX);
+            e.alu_r32_r32(ALU_ADD, RAX, RCX);
+            e.movzx_r32_r8(RAX, RAX);
+            store(ins.x, RAX);
+            break;
+        case OP_8XY5:
+        case OP_8XY7:
+            load(ins.x, RAX);
+            load(ins.y, RCX);
+            e.alu_r32_r32(ALU_CMP, RAX, RCX);
+            e.setcc_r8(ins.op == OP_8XY5 ? CC_AE : CC_A, RDX);
+            e.movzx_r32_r8(RDX, RDX);
+            store(0xF, RDX);
+            load(ins.x, RAX);
+            load(ins.y, RCX);
+            if (ins.op == OP_8XY5)
+            {
+                e.alu_r32_r32(ALU_SUB, RAX, RCX);
+                e.movzx_r32_r8(RAX, RAX);
+                store(ins.x, RAX);
+            }
+            else
+            {
+                e.alu_r32_r32(ALU_SUB, RCX, RAX);
+                e.movzx_r32_r8(RCX, RCX);
+                store(ins.x, RCX);
+            }
+            break;
+        // The flag is the bit shifted out and written after the result
+        case OP_8XY6:
+        case OP_8XYE:
+            load(quirks.shift_vy ? ins.y : ins.x, RAX);
+            e.mov_r32_r32(RCX, RAX);
+            if (ins.op == OP_8XY6)
+            {
+                e.alu_r32_imm(ALU_AND, RCX, 1);
+                e.shr_r32_1(RAX);
+            }
+            else
+            {
+                e.shr_r32_imm(RCX, 7);
+                e.shl_r32_1(RAX);
+                e.movzx_r32_r8(RAX, RAX);
+            }
+            store(ins.x, RAX);
+            store(0xF, RCX);
+            break;
+        case OP_ANNN:
+            e.mov_r32_imm(RAX, ins.nnn);
+            store(GUEST_I, RAX);
+            break;
+        case OP_CXNN:
+            call((const void *)jit_random, ins.x, ins.nn);
+            break;
+        case OP_DXYN:
+            call((const void *)jit_draw, ins.x, ins.y, ins.n);
+            break;
+        case OP_FX07:
+            sync_cycle();
+            call((const void *)jit_read_delay, ins.x);
+            break;
+        case OP_FX15:
+            sync_cycle();
+            call((const void *)jit_set_delay, ins.x);
+            break;
+        case OP_FX18:
+            sync_cycle();
+            call((const void *)jit_set_sound, ins.x);
+            break;
+        case OP_FX1E:
+            load(GUEST_I, RAX);
+            load(ins.x, RCX);
+            e.alu_r32_r32(ALU_ADD, RAX, RCX);
+            e.movzx_r32_r16(RAX, RAX);
+            store(GUEST_I, RAX);
+            break;
+        case OP_FX29:
+            load(ins.x, RAX);
+            e.lea_r32(RAX, RAX, RAX, 4);
+            store(GUEST_I, RAX);
+            break;
+        case OP_FX33:
+            call((const void *)jit_store_bcd, ins.x);
+            break;
+        case OP_FX55:
+            call((const void *)jit_store_registers, ins.x, load_store_advance(quirks.load_store_i, ins.x));
+            break;
+        case OP_FX65:
+            call((const void *)jit_load_registers, ins.x, load_store_advance(quirks.load_store_i, ins.x));
+            break;
+        default:
+            return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+// Behaviour that differs between the CHIP-8 platforms. Each policy is a type, the engines are
+// instantiated once per platform so a quirk costs nothing at run time
+//
+//   shift_vy       8XY6/8XYE shift VY into VX instead of shifting VX in place
+//   load_store_i   what FX55/FX65 leave in I: 0 unchanged, 1 I + X, 2 I + X + 1
+//   jump_vx        BNNN is BXNN and jumps to XNN + VX instead of NNN + V0
+//   vf_reset       8XY1/8XY2/8XY3 clear VF
+
+enum Platform
+{
+    PLATFORM_VIP,
+    PLATFORM_CHIP48,
+    PLATFORM_SCHIP,
+    PLATFORM_XOCHIP,
+    PLATFORM_COUNT
+};
+
+extern const char *platform_names[PLATFORM_COUNT];
+
+// The original COSMAC VIP interpreter
+struct QuirksVIP
+{
+    static const bool shift_vy = true;
+    static const int load_store_i = 2;
+    static const bool jump_vx = false;
+    static const bool vf_reset = true;
+};
+
+// CHIP-48 on the HP-48, FX55/FX65 leave I one short
+struct QuirksCHIP48
+{
+    static const bool shift_vy = false;
+    static const int load_store_i = 1;
+    static const bool jump_vx = true;
+    static const bool vf_reset = false;
+};
+
+// SUPER-CHIP 1.1
+struct QuirksSCHIP
+{
+    static const bool shift_vy = false;
+    static const int load_store_i = 0;
+    static const bool jump_vx = true;
+    static const bool vf_reset = false;
+};
+
+struct QuirksXOCHIP
+{
+    static const bool shift_vy = true;
+    static const int load_store_i = 2;
+    static const bool jump_vx = false;
+    static const bool vf_reset = false;
+};
+
+// The same flags as values, for code that is generated rather than instantiated
+struct QuirkFlags
+{
+    bool shift_vy;
+    int load_store_i;
+    bool jump_vx;
+    bool vf_reset;
+};
+
+extern const QuirkFlags platform_quirks[PLATFORM_COUNT];
+
+// What I advances by after FX55/FX65
+static inline int load_store_advance(int load_store_i, int x)
+{
+    return load_store_i == 0 ? 0 : load_store_i == 1 ? x : x + 1;
+}
+
+// Runs statement with Q typedef'd to the policy of platform
+#define QUIRKS_DISPATCH(platform, statement)    \
+    switch (platform)                           \
+    {                                           \
+    case PLATFORM_CHIP48:                       \
+    {                                           \
+        typedef QuirksCHIP48 Q;                 \
+        statement;                              \
+    }                                           \
+    break;                                      \
+    case PLATFORM_SCHIP:                        \
+    {                                           \
+        typedef QuirksSCHIP Q;                  \
+        statement;                              \
+    }                                           \
+    break;                                      \
+    case PLATFORM_XOCHIP:                       \
+    {                                           \
+        typedef QuirksXOCHIP Q;                 \
+        statement;                              \
+    }                                           \
+    break;                                      \
+    default:                                    \
+    {                                           \
+        typedef QuirksVIP Q;                    \
+        statement;                              \
+    }                                           \
+    break;                                      \
+    }
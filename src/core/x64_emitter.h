@@ -0,0 +1,322 @@
+#pragma once
+
+#include <string.h>
+
+// Minimal x86-64 machine code emitter, just the instruction forms the JIT needs.
+// Memory operands are always [base + index * scale + disp32]
+
+enum X64Reg
+{
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+    NO_REG = -1
+};
+
+enum X64Cond
+{
+    CC_O = 0x0,
+    CC_NO = 0x1,
+    CC_B = 0x2,
+    CC_AE = 0x3,
+    CC_E = 0x4,
+    CC_NE = 0x5,
+    CC_BE = 0x6,
+    CC_A = 0x7,
+    CC_S = 0x8,
+    CC_NS = 0x9,
+    CC_L = 0xC,
+    CC_GE = 0xD,
+    CC_LE = 0xE,
+    CC_G = 0xF
+};
+
+// The /digit of the 0x81 group and the opcode of the matching reg, reg form
+enum X64Alu
+{
+    ALU_ADD = 0,
+    ALU_OR = 1,
+    ALU_AND = 4,
+    ALU_SUB = 5,
+    ALU_XOR = 6,
+    ALU_CMP = 7
+};
+
+struct X64Emitter
+{
+    unsigned char *code;
+    size_t size;
+    size_t capacity;
+    bool overflow;
+
+    void init(unsigned char *buffer, size_t bytes)
+    {
+        code = buffer;
+        size = 0;
+        capacity = bytes;
+        overflow = false;
+    }
+
+    unsigned char *here() { return code + size; }
+
+    void byte(int b)
+    {
+        if (size < capacity)
+            code[size++] = (unsigned char)b;
+        else
+            overflow = true;
+    }
+
+    void word(int w)
+    {
+        byte(w);
+        byte(w >> 8);
+    }
+
+    void dword(unsigned int d)
+    {
+        for (int i = 0; i < 4; i++)
+            byte(d >> (i * 8));
+    }
+
+    void qword(unsigned long long q)
+    {
+        for (int i = 0; i < 8; i++)
+            byte((int)(q >> (i * 8)));
+    }
+
+    void rex(bool w, int reg, int index, int base, bool force = false)
+    {
+        int r = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((index != NO_REG && (index & 8)) ? 2 : 0) | ((base != NO_REG && (base & 8)) ? 1 : 0);
+        if (r != 0x40 || force)
+            byte(r);
+    }
+
+    void modrm_reg(int reg, int rm)
+    {
+        byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+    }
+
+    void modrm_mem(int reg, int base, int index, int scale, int disp)
+    {
+        if (index == NO_REG)
+        {
+            byte(0x80 | (reg & 7) << 3 | (base & 7));
+            if ((base & 7) == RSP)
+                byte(0x24);
+        }
+        else
+        {
+            int ss = scale == 8 ? 3 : scale == 4 ? 2 : scale == 2 ? 1 : 0;
+            byte(0x80 | (reg & 7) << 3 | 4);
+            byte(ss << 6 | (index & 7) << 3 | (base & 7));
+        }
+        dword(disp);
+    }
+
+    // op r/m, reg with an optional 0x0F escape
+    void op_mem(int opcode, bool escape, bool w, int reg, int base, int index, int scale, int disp, bool force_rex = false)
+    {
+        rex(w, reg, index, base, force_rex);
+        if (escape)
+            byte(0x0F);
+        byte(opcode);
+        modrm_mem(reg, base, index, scale, disp);
+    }
+
+    void op_reg(int opcode, bool escape, bool w, int reg, int rm)
+    {
+        rex(w, reg, NO_REG, rm);
+        if (escape)
+            byte(0x0F);
+        byte(opcode);
+        modrm_reg(reg, rm);
+    }
+
+    void mov_r32_imm(int dst, unsigned int imm)
+    {
+        rex(false, 0, NO_REG, dst);
+        byte(0xB8 + (dst & 7));
+        dword(imm);
+    }
+
+    void mov_r64_imm(int dst, unsigned long long imm)
+    {
+        rex(true, 0, NO_REG, dst);
+        byte(0xB8 + (dst & 7));
+        qword(imm);
+    }
+
+    void mov_r32_r32(int dst, int src)
+    {
+        if (dst != src)
+            op_reg(0x89, false, false, src, dst);
+    }
+
+    void mov_r64_r64(int dst, int src) { op_reg(0x89, false, true, src, dst); }
+
+    void alu_r32_r32(X64Alu alu, int dst, int src) { op_reg(alu << 3 | 1, false, false, src, dst); }
+
+    void alu_r32_imm(X64Alu alu, int dst, unsigned int imm)
+    {
+        rex(false, 0, NO_REG, dst);
+        byte(0x81);
+        modrm_reg(alu, dst);
+        dword(imm);
+    }
+
+    void alu_r64_imm8(X64Alu alu, int dst, int imm)
+    {
+        rex(true, 0, NO_REG, dst);
+        byte(0x83);
+        modrm_reg(alu, dst);
+        byte(imm);
+    }
+
+    void test_r32_r32(int a, int b) { op_reg(0x85, false, false, b, a); }
+
+    void shr_r32_1(int dst) { op_reg(0xD1, false, false, 5, dst); }
+    void shl_r32_1(int dst) { op_reg(0xD1, false, false, 4, dst); }
+
+    void shr_r32_imm(int dst, int imm)
+    {
+        op_reg(0xC1, false, false, 5, dst);
+        byte(imm);
+    }
+
+    // The low bytes of RSP, RBP, RSI and RDI are only reachable with a REX prefix
+    void movzx_r32_r8(int dst, int src)
+    {
+        rex(false, dst, NO_REG, src, (src & 0xC) == 4);
+        byte(0x0F);
+        byte(0xB6);
+        modrm_reg(dst, src);
+    }
+
+    void movzx_r32_r16(int dst, int src) { op_reg(0xB7, true, false, dst, src); }
+
+    // Only for RAX, RCX, RDX and RBX
+    void setcc_r8(X64Cond cc, int dst) { op_reg(0x90 + cc, true, false, 0, dst); }
+
+    void cmovcc_r32_r32(X64Cond cc, int dst, int src) { op_reg(0x40 + cc, true, false, dst, src); }
+
+    void movzx_r32_m8(int dst, int base, int disp, int index = NO_REG, int scale = 1) { op_mem(0xB6, true, false, dst, base, index, scale, disp); }
+    void movzx_r32_m16(int dst, int base, int disp, int index = NO_REG, int scale = 1) { op_mem(0xB7, true, false, dst, base, index, scale, disp); }
+
+    void mov_m8_r8(int base, int disp, int src, int index = NO_REG, int scale = 1) { op_mem(0x88, false, false, src, base, index, scale, disp, (src & 0xC) == 4); }
+
+    void mov_m16_r16(int base, int disp, int src, int index = NO_REG, int scale = 1)
+    {
+        byte(0x66);
+        op_mem(0x89, false, false, src, base, index, scale, disp);
+    }
+
+    void mov_m8_imm(int base, int disp, int imm)
+    {
+        op_mem(0xC6, false, false, 0, base, NO_REG, 1, disp);
+        byte(imm);
+    }
+
+    void mov_m16_imm(int base, int disp, int imm, int index = NO_REG, int scale = 1)
+    {
+        byte(0x66);
+        op_mem(0xC7, false, false, 0, base, index, scale, disp);
+        word(imm);
+    }
+
+    void mov_r32_m32(int dst, int base, int disp) { op_mem(0x8B, false, false, dst, base, NO_REG, 1, disp); }
+    void mov_m32_r32(int base, int disp, int src) { op_mem(0x89, false, false, src, base, NO_REG, 1, disp); }
+    void mov_r64_m64(int dst, int base, int disp) { op_mem(0x8B, false, true, dst, base, NO_REG, 1, disp); }
+    void mov_m64_r64(int base, int disp, int src) { op_mem(0x89, false, true, src, base, NO_REG, 1, disp); }
+
+    void cmp_m8_imm(int base, int disp, int imm)
+    {
+        op_mem(0x80, false, false, ALU_CMP, base, NO_REG, 1, disp);
+        byte(imm);
+    }
+
+    void add_m32_imm(int base, int disp, unsigned int imm)
+    {
+        op_mem(0x81, false, false, ALU_ADD, base, NO_REG, 1, disp);
+        dword(imm);
+    }
+
+    void add_m64_imm(int base, int disp, unsigned int imm)
+    {
+        op_mem(0x81, false, true, ALU_ADD, base, NO_REG, 1, disp);
+        dword(imm);
+    }
+
+    void sub_m32_imm(int base, int disp, unsigned int imm)
+    {
+        op_mem(0x81, false, false, ALU_SUB, base, NO_REG, 1, disp);
+        dword(imm);
+    }
+
+    // lea dst, [base + index * scale]
+    void lea_r32(int dst, int base, int index, int scale)
+    {
+        int ss = scale == 8 ? 3 : scale == 4 ? 2 : scale == 2 ? 1 : 0;
+        rex(false, dst, index, base);
+        byte(0x8D);
+        byte(0x04 | (dst & 7) << 3);
+        byte(ss << 6 | (index & 7) << 3 | (base & 7));
+        // rbp and r13 as a base need an explicit displacement
+        if ((base & 7) == RBP)
+        {
+            code[size - 2] |= 0x40;
+            byte(0);
+        }
+    }
+
+    void push(int reg)
+    {
+        rex(false, 0, NO_REG, reg);
+        byte(0x50 + (reg & 7));
+    }
+
+    void pop(int reg)
+    {
+        rex(false, 0, NO_REG, reg);
+        byte(0x58 + (reg & 7));
+    }
+
+    void call_abs(const void *target)
+    {
+        mov_r64_imm(RAX, (unsigned long long)target);
+        byte(0xFF);
+        byte(0xD0);
+    }
+
+    void jmp_r64(int reg)
+    {
+        rex(false, 0, NO_REG, reg);
+        byte(0xFF);
+        modrm_reg(4, reg);
+    }
+
+    void ret() { byte(0xC3); }
+
+    // Relative branches return the offset of their rel32 field so it can be patched later
+    size_t jmp_rel32(const unsigned char *target)
+    {
+        byte(0xE9);
+        size_t at = size;
+        dword((unsigned int)(target - (code + size + 4)));
+        return at;
+    }
+
+    size_t jcc_rel32(X64Cond cc, const unsigned char *target)
+    {
+        byte(0x0F);
+        byte(0x80 + cc);
+        size_t at = size;
+        dword((unsigned int)(target - (code + size + 4)));
+        return at;
+    }
+
+    static void patch_rel32(unsigned char *field, const unsigned char *target)
+    {
+        int rel = (int)(target - (field + 4));
+        memcpy(field, &rel, 4);
+    }
+};
@@ -0,0 +1,306 @@
+#include "emu_thread.h"
+#include "sdl_frontend.h"
+#include <chrono>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+// Frames of emulated time the thread catches up on after a stall, anything older is dropped
+#define MAX_LAG_FRAMES 4
+
+// Audio pacing wakes about four times per 512 sample callback at 44.1 kHz
+#define AUDIO_WAKE_NS (1000000000ull / 240)
+
+// The ring's distance from half full is closed over this many wakes, a gentle correction on top
+// of the device's own rate keeps the pitch steady and the ring away from both ends
+#define AUDIO_SMOOTHING 16
+
+const char *pacing_names[PACING_COUNT] = {
+    "counter",
+    "audio"
+};
+
+void EmuThread::start(CHIP_8 *chip, Engine engine, SdlFrontend *audio, int speed, Pacing pacing)
+{
+    this->chip = chip;
+    this->engine = engine;
+    this->audio = audio;
+    this->speed = speed > 0 ? speed : 1;
+    chip->set_speed(this->speed);
+    chip->frontend = this;
+    this->pacing = pacing;
+    if (pacing == PACE_AUDIO && !(audio && audio->start_clock()))
+    {
+        printf("no audio device to pace against, using the performance counter\n");
+        this->pacing = PACE_COUNTER;
+    }
+    running = true;
+    thread = std::thread(&EmuThread::run, this);
+}
+
+void EmuThread::stop()
+{
+    running = false;
+    if (thread.joinable())
+        thread.join();
+}
+
+bool EmuThread::send(CommandType type, int addr, int value, const char *path)
+{
+    Command command;
+    command.type = type;
+    command.addr = addr;
+    command.value = value;
+    command.path[0] = 0;
+    if (path)
+    {
+        strncpy(command.path, path, sizeof(command.path) - 1);
+        command.path[sizeof(command.path) - 1] = 0;
+    }
+    return commands.push(command);
+}
+
+void EmuThread::apply(const Command &command)
+{
+    switch (command.type)
+    {
+    case COMMAND_RESTART:
+        chip->restart();
+        break;
+    case COMMAND_PAUSE:
+        paused = command.value != 0;
+        steps = 0;
+        break;
+    case COMMAND_STEP:
+        steps += command.value;
+        break;
+    case COMMAND_LOAD_ROM:
+        // Nothing of the last rom survives, neither its tail in memory nor code compiled from it
+        chip->restart();
+        memset(chip->memory + 0x200, 0, sizeof(chip->memory) - 0x200);
+        chip->loadfile(command.path, chip->platform);
+        chip->invalidate(0x200, sizeof(chip->memory) - 0x200);
+        break;
+    case COMMAND_POKE:
+        chip->memory[command.addr & 0xFFF] = command.value;
+        chip->invalidate(command.addr & 0xFFF, 1);
+        break;
+    case COMMAND_POKE_DISPLAY:
+    {
+        int offset = command.addr & (sizeof(chip->display) - 1);
+        int shift = 56 - offset % 8 * 8;
+        unsigned long long &row = chip->display[offset / 8];
+        row = (row & ~(0xFFull << shift)) | (unsigned long long)(command.value & 0xFF) << shift;
+        chip->dirty_rows |= 1u << (offset / 8);
+        break;
+    }
+    case COMMAND_BREAKPOINT:
+        chip->set_breakpoint(command.addr, command.value != 0);
+        break;
+    case COMMAND_SPEED:
+        speed = command.value > 0 ? command.value : 1;
+        chip->set_speed(speed);
+        break;
+    }
+}
+
+// Runs count instructions in slices that end at the machine's 60 Hz frame boundaries, with
+// the keys polled at the start of each
+void EmuThread::run_instructions(unsigned long long count)
+{
+    while (count > 0 && !paused)
+    {
+        chip->poll_input();
+        unsigned long long slice = std::min(chip->next_tick_cycle() - chip->cycle, count);
+        last_run = chip->execute(engine, (int)slice);
+        count -= slice;
+        if (last_run == RUN_BREAKPOINT)
+            paused = true;
+    }
+}
+
+// Runs count samples' worth of instructions and queues the buzzer for them. carry is in units
+// of 1 / (speed * sample_rate) seconds: an instruction adds sample_rate and a sample takes speed
+// away. An instruction can be worth many samples, what it ran ahead stays in carry for the next
+// call, so exactly count samples go out and they always match the instructions run
+void EmuThread::run_samples(long long count, unsigned long long &carry)
+{
+    unsigned long long rate = audio->sample_rate;
+    while (count > 0 && !paused)
+    {
+        unsigned long long units = count * speed;
+        if (carry < units)
+        {
+            chip->poll_input();
+            unsigned long long slice = std::min(chip->next_tick_cycle() - chip->cycle, (units - carry + rate - 1) / rate);
+            last_run = chip->execute(engine, (int)slice);
+            if (last_run == RUN_BREAKPOINT)
+                paused = true;
+            carry += slice * rate;
+        }
+
+        long long made = std::min((long long)(carry / speed), count);
+        carry -= made * speed;
+        audio->queue_samples((int)made, chip->sound() > 0);
+        count -= made;
+    }
+    // Stopped at a breakpoint, the device gets silence for the rest
+    if (count > 0)
+        audio->queue_samples((int)count, false);
+}
+
+void EmuThread::step()
+{
+    if (steps > 0)
+    {
+        chip->poll_input();
+        last_run = chip->execute(engine, 1);
+        steps--;
+    }
+}
+
+void EmuThread::finish_batch()
+{
+    chip->present();
+    if (inspect.load(std::memory_order_relaxed))
+        publish_snapshot();
+}
+
+void EmuThread::run()
+{
+    if (pacing == PACE_AUDIO)
+        pace_audio();
+    else
+        pace_counter();
+}
+
+// The audio device is the clock. Every wake queues as many samples as it took since the last
+// one, plus a share of the ring's distance from half full, and runs the instructions those
+// samples are worth. The machine so runs at the device's real rate, which drifts a little from
+// the nominal one, and the buffered audio stays at about half the ring
+void EmuThread::pace_audio()
+{
+    // Half a ring of silence to start from, the controller only closes gaps slowly
+    audio->queue_samples(AUDIO_RING / 2, false);
+    unsigned long long heard = audio->played;
+    unsigned long long carry = 0;
+    while (running)
+    {
+        Command command;
+        while (commands.pop(command))
+            apply(command);
+
+        unsigned long long played = audio->played;
+        long long queued = audio->samples.size();
+        long long count = (long long)(played - heard) + (AUDIO_RING / 2 - queued) / AUDIO_SMOOTHING;
+        heard = played;
+        count = std::max(0ll, std::min(count, AUDIO_RING - 1 - queued));
+
+        if (!paused)
+            run_samples(count, carry);
+        else
+        {
+            // Silence keeps the ring where it is, so resuming doesn't start from empty
+            audio->queue_samples((int)count, false);
+            step();
+        }
+        finish_batch();
+
+        std::this_thread::sleep_for(std::chrono::nanoseconds(AUDIO_WAKE_NS));
+    }
+}
+
+// Wakes at 60 Hz and runs the instructions the time since the last wake is worth. The
+// performance counter ticks that weren't enough for a whole instruction carry over, so the
+// rate comes out exact over time whatever the sleeps do
+void EmuThread::pace_counter()
+{
+    unsigned long long frequency = SDL_GetPerformanceFrequency();
+    unsigned long long frame = frequency / 60;
+    unsigned long long last = SDL_GetPerformanceCounter();
+    // Counter ticks not yet paid for in instructions
+    unsigned long long owed = 0;
+    while (running)
+    {
+        Command command;
+        while (commands.pop(command))
+            apply(command);
+
+        unsigned long long now = SDL_GetPerformanceCounter();
+        owed += now - last;
+        last = now;
+        // A long stall would otherwise be paid back in one huge batch that stalls the next
+        // wake in turn. Past MAX_LAG_FRAMES the time is written off instead
+        if (owed > frame * MAX_LAG_FRAMES)
+        {
+            dropped += (owed - frame * MAX_LAG_FRAMES) * speed / frequency;
+            owed = frame * MAX_LAG_FRAMES;
+        }
+
+        if (!paused)
+        {
+            unsigned long long count = owed * speed / frequency;
+            owed -= count * frequency / speed;
+            run_instructions(count);
+        }
+        else
+        {
+            // Time spent paused is not owed once it resumes
+            owed = 0;
+            step();
+        }
+        finish_batch();
+
+        unsigned long long elapsed = SDL_GetPerformanceCounter() - last;
+        if (elapsed < frame)
+            std::this_thread::sleep_for(std::chrono::nanoseconds((frame - elapsed) * 1000000000ull / frequency));
+    }
+}
+
+void EmuThread::publish_snapshot()
+{
+    DebugState &state = snapshots.write_buffer();
+    state.pc = chip->pc;
+    state.opcode = chip->opcode;
+    state.I = chip->I;
+    state.sp = chip->sp;
+    memcpy(state.V, chip->V, sizeof(state.V));
+    memcpy(state.stack, chip->stack, sizeof(state.stack));
+    state.delay = chip->delay();
+    state.sound = chip->sound();
+    state.platform = chip->platform;
+
+    memcpy(state.memory, chip->memory, sizeof(state.memory));
+    memcpy(state.display, chip->display, sizeof(state.display));
+    memcpy(state.breakpoints, chip->breakpoints, sizeof(state.breakpoints));
+
+    state.cycle = chip->cycle;
+    state.idle_skipped = chip->idle_skipped;
+    state.published = published;
+    state.speed = speed;
+    state.dropped = dropped;
+    state.paused = paused;
+    state.last_run = last_run;
+
+    state.jit = chip->jit != NULL;
+    if (chip->jit)
+        state.jit_stats = chip->jit->stats;
+    snapshots.publish();
+}
+
+// Called by present() on the emulation thread, frames that didn't change aren't published
+void EmuThread::draw(const unsigned long long *display, unsigned int dirty_rows)
+{
+    if (!dirty_rows)
+        return;
+    Frame &frame = frames.write_buffer();
+    memcpy(frame.display, display, sizeof(frame.display));
+    frame.dirty_rows = dirty_rows;
+    frame.sequence = ++published;
+    frames.publish();
+}
+
+void EmuThread::beep(bool on)
+{
+    audio->beep(on);
+}
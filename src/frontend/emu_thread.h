@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include "core/chip8.h"
+#include "core/jit_x64.h"
+#include "triple_buffer.h"
+#include "spsc_queue.h"
+
+struct SdlFrontend;
+
+// A finished frame as the emulation thread published it
+struct Frame
+{
+    unsigned long long display[32];
+    // Rows that changed since the frame before this one
+    unsigned int dirty_rows;
+    // Counts published frames, a gap means the reader missed some and dirty_rows isn't enough
+    unsigned long long sequence;
+};
+
+// What the debug windows show, copied from the machine between two batches so registers,
+// memory and display always come from the same instant
+struct DebugState
+{
+    unsigned short pc;
+    unsigned short opcode;
+    unsigned short I;
+    unsigned short sp;
+    unsigned char V[16];
+    unsigned short stack[16];
+    unsigned char delay;
+    unsigned char sound;
+    Platform platform;
+
+    unsigned char memory[4 * 1024];
+    unsigned long long display[32];
+    unsigned char breakpoints[4 * 1024];
+
+    unsigned long long cycle;
+    unsigned long long idle_skipped;
+    unsigned long long published;
+    int speed;
+    unsigned long long dropped;
+    bool paused;
+    RunResult last_run;
+
+    bool jit;
+    JitStats jit_stats;
+};
+
+// Everything the UI asks of the machine, applied by the emulation thread between batches
+enum CommandType
+{
+    COMMAND_RESTART,
+    COMMAND_PAUSE,        // value 1 pauses, 0 resumes
+    COMMAND_STEP,         // value instructions, run while paused
+    COMMAND_LOAD_ROM,     // restarts with path on the machine's platform
+    COMMAND_POKE,         // memory[addr] = value
+    COMMAND_POKE_DISPLAY, // byte addr of the display = value, 8 per row from the left edge
+    COMMAND_BREAKPOINT,   // at addr, value 1 sets and 0 clears
+    COMMAND_SPEED         // value instructions per second
+};
+
+struct Command
+{
+    CommandType type;
+    int addr;
+    int value;
+    char path[256];
+};
+
+// What decides how fast the emulation thread runs the machine
+enum Pacing
+{
+    PACE_COUNTER, // SDL's performance counter, see EmuThread::pace_counter()
+    PACE_AUDIO,   // the audio device's consumption, see EmuThread::pace_audio()
+    PACING_COUNT
+};
+
+extern const char *pacing_names[PACING_COUNT];
+
+// Runs the machine on its own thread at speed instructions per second, timed by SDL's performance
+// counter or by the audio device, so neither the UI's frame time nor the display's refresh rate
+// decides how fast the guest runs. It is the machine's Frontend: frames go out through a triple
+// buffer for the render thread, the buzzer to the audio device
+struct EmuThread : Frontend
+{
+    CHIP_8 *chip;
+    Engine engine;
+    SdlFrontend *audio;
+    // Falls back to PACE_COUNTER in start() without an audio device
+    Pacing pacing;
+
+    TripleBuffer<Frame> frames;
+    unsigned long long published;
+
+    // The UI's commands, drained at the start of every batch
+    SpscQueue<Command, 256> commands;
+
+    // The UI reads the machine only through these, published after every batch while inspect
+    // is set. The UI sets inspect while a debug window is open, otherwise nothing is copied
+    TripleBuffer<DebugState> snapshots;
+    std::atomic<bool> inspect;
+
+    // Owned by the emulation thread, the UI sees them through snapshots
+    // Instructions per second
+    int speed;
+    // Instructions written off after stalls, see run()
+    unsigned long long dropped;
+    bool paused;
+    RunResult last_run;
+    // Single instructions left to run while paused
+    int steps;
+
+    std::atomic<bool> running;
+    std::thread thread;
+
+    EmuThread() : chip(NULL), engine(ENGINE_BATCH), audio(NULL), pacing(PACE_COUNTER), published(0), inspect(false),
+                  speed(CHIP8_DEFAULT_SPEED), dropped(0), paused(false), last_run(RUN_CYCLES_EXHAUSTED), steps(0), running(false) {}
+
+    void start(CHIP_8 *chip, Engine engine, SdlFrontend *audio, int speed, Pacing pacing = PACE_COUNTER);
+    void stop();
+    void run();
+    void pace_counter();
+    void pace_audio();
+    void run_instructions(unsigned long long count);
+    void run_samples(long long count, unsigned long long &carry);
+    void step();
+    void finish_batch();
+
+    // UI thread, false if the queue is full and the command was dropped
+    bool send(CommandType type, int addr = 0, int value = 0, const char *path = NULL);
+    void apply(const Command &command);
+    void publish_snapshot();
+
+    void draw(const unsigned long long *display, unsigned int dirty_rows);
+    void beep(bool on);
+};
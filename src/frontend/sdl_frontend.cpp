@@ -0,0 +1,309 @@
+#include "sdl_frontend.h"
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL_opengl.h>
+
+// Bytes of one RGBA frame, the size of every buffer in the ring
+#define FRAME_BYTES (64 * 32 * 4)
+
+const char *upload_path_names[UPLOAD_PATH_COUNT] = {
+    "persistent",
+    "orphan",
+    "direct"
+};
+
+// Buffer and sync entry points past GL 1.1, loaded by init(). NULL where the driver has none
+static struct
+{
+    PFNGLGENBUFFERSPROC gen_buffers;
+    PFNGLDELETEBUFFERSPROC delete_buffers;
+    PFNGLBINDBUFFERPROC bind_buffer;
+    PFNGLBUFFERDATAPROC buffer_data;
+    PFNGLBUFFERSTORAGEPROC buffer_storage;
+    PFNGLMAPBUFFERRANGEPROC map_buffer_range;
+    PFNGLUNMAPBUFFERPROC unmap_buffer;
+    PFNGLFENCESYNCPROC fence_sync;
+    PFNGLCLIENTWAITSYNCPROC client_wait_sync;
+    PFNGLDELETESYNCPROC delete_sync;
+} gl;
+
+static void load_gl()
+{
+    gl.gen_buffers = (PFNGLGENBUFFERSPROC)SDL_GL_GetProcAddress("glGenBuffers");
+    gl.delete_buffers = (PFNGLDELETEBUFFERSPROC)SDL_GL_GetProcAddress("glDeleteBuffers");
+    gl.bind_buffer = (PFNGLBINDBUFFERPROC)SDL_GL_GetProcAddress("glBindBuffer");
+    gl.buffer_data = (PFNGLBUFFERDATAPROC)SDL_GL_GetProcAddress("glBufferData");
+    gl.buffer_storage = (PFNGLBUFFERSTORAGEPROC)SDL_GL_GetProcAddress("glBufferStorage");
+    gl.map_buffer_range = (PFNGLMAPBUFFERRANGEPROC)SDL_GL_GetProcAddress("glMapBufferRange");
+    gl.unmap_buffer = (PFNGLUNMAPBUFFERPROC)SDL_GL_GetProcAddress("glUnmapBuffer");
+    gl.fence_sync = (PFNGLFENCESYNCPROC)SDL_GL_GetProcAddress("glFenceSync");
+    gl.client_wait_sync = (PFNGLCLIENTWAITSYNCPROC)SDL_GL_GetProcAddress("glClientWaitSync");
+    gl.delete_sync = (PFNGLDELETESYNCPROC)SDL_GL_GetProcAddress("glDeleteSync");
+}
+
+// The first path from preferred down that the context supports. A driver can hand out entry
+// points it doesn't implement, so the version and extensions decide and the pointers only confirm
+static UploadPath pick_upload(UploadPath preferred)
+{
+    int major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    int version = major * 10 + minor;
+
+    bool buffers = version >= 30 && gl.gen_buffers && gl.delete_buffers && gl.bind_buffer && gl.buffer_data &&
+                   gl.map_buffer_range && gl.unmap_buffer;
+    bool sync = (version >= 32 || SDL_GL_ExtensionSupported("GL_ARB_sync")) && gl.fence_sync && gl.client_wait_sync &&
+                gl.delete_sync;
+    bool storage = (version >= 44 || SDL_GL_ExtensionSupported("GL_ARB_buffer_storage")) && gl.buffer_storage;
+
+    if (preferred == UPLOAD_PERSISTENT && buffers && sync && storage)
+        return UPLOAD_PERSISTENT;
+    if (preferred <= UPLOAD_ORPHAN && buffers)
+        return UPLOAD_ORPHAN;
+    return UPLOAD_DIRECT;
+}
+
+// Square wave pitch and amplitude
+#define BEEP_HZ 440
+#define BEEP_VOLUME 2000
+
+const SDL_Scancode keymap[0x10] = {
+    SDL_SCANCODE_0,
+    SDL_SCANCODE_1,
+    SDL_SCANCODE_2,
+    SDL_SCANCODE_3,
+    SDL_SCANCODE_4,
+    SDL_SCANCODE_5,
+    SDL_SCANCODE_6,
+    SDL_SCANCODE_7,
+    SDL_SCANCODE_8,
+    SDL_SCANCODE_9,
+    SDL_SCANCODE_A,
+    SDL_SCANCODE_B,
+    SDL_SCANCODE_C,
+    SDL_SCANCODE_D,
+    SDL_SCANCODE_E,
+    SDL_SCANCODE_F
+};
+
+void SdlInput::capture()
+{
+    const unsigned char *state = SDL_GetKeyboardState(NULL);
+    unsigned int down = 0;
+    for (int i = 0; i < 0x10; i++)
+        down |= (unsigned int)(state[keymap[i]] != 0) << i;
+    held.store(down, std::memory_order_relaxed);
+}
+
+void SdlInput::poll(unsigned char keys[16])
+{
+    unsigned int down = held.load(std::memory_order_relaxed);
+    for (int i = 0; i < 0x10; i++)
+        keys[i] = down >> i & 1;
+}
+
+static inline Sint16 square_wave(unsigned int &phase, int sample_rate)
+{
+    return (phase++ / (sample_rate / (BEEP_HZ * 2))) & 1 ? BEEP_VOLUME : -BEEP_VOLUME;
+}
+
+// Runs on SDL's audio thread. Unclocked the device is paused whenever the buzzer is off
+static void fill_audio(void *userdata, Uint8 *stream, int len)
+{
+    SdlFrontend *frontend = (SdlFrontend *)userdata;
+    Sint16 *samples = (Sint16 *)stream;
+    int count = len / 2;
+    if (!frontend->clocked)
+    {
+        for (int i = 0; i < count; i++)
+            samples[i] = square_wave(frontend->phase, frontend->sample_rate);
+        return;
+    }
+
+    int i = 0;
+    short sample;
+    while (i < count && frontend->samples.pop(sample))
+        samples[i++] = sample;
+    if (i < count)
+    {
+        frontend->underruns += count - i;
+        memset(samples + i, 0, (count - i) * sizeof(Sint16));
+    }
+    frontend->played += count;
+}
+
+bool SdlFrontend::init(UploadPath preferred)
+{
+    expand = expand_kernel(expand_best_kernel());
+    off_colour = 0xFF000000;
+    on_colour = 0xFFFFFFFF;
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 64, 32, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    load_gl();
+    upload = pick_upload(preferred);
+    if (upload != UPLOAD_DIRECT)
+    {
+        gl.gen_buffers(PBO_RING, pbos);
+        for (int i = 0; i < PBO_RING; i++)
+        {
+            gl.bind_buffer(GL_PIXEL_UNPACK_BUFFER, pbos[i]);
+            if (upload == UPLOAD_ORPHAN)
+            {
+                gl.buffer_data(GL_PIXEL_UNPACK_BUFFER, FRAME_BYTES, NULL, GL_STREAM_DRAW);
+                continue;
+            }
+            // Coherent, so writes through the mapping need no flush before the upload reads them
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            gl.buffer_storage(GL_PIXEL_UNPACK_BUFFER, FRAME_BYTES, NULL, flags);
+            mapped[i] = (unsigned int *)gl.map_buffer_range(GL_PIXEL_UNPACK_BUFFER, 0, FRAME_BYTES, flags);
+        }
+        gl.bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    printf("uploading frames through %s\n", upload_path_names[upload]);
+
+    SDL_AudioSpec want = {}, have;
+    want.freq = 44100;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = 512;
+    want.callback = fill_audio;
+    want.userdata = this;
+
+    audio = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+    if (!audio)
+    {
+        printf("no audio: %s\n", SDL_GetError());
+        return false;
+    }
+    sample_rate = have.freq;
+    return true;
+}
+
+void SdlFrontend::shutdown_upload()
+{
+    if (upload == UPLOAD_DIRECT)
+        return;
+    for (int i = 0; i < PBO_RING; i++)
+        if (fences[i])
+            gl.delete_sync((GLsync)fences[i]);
+    // Deleting a buffer drops its persistent mapping too
+    gl.delete_buffers(PBO_RING, pbos);
+    memset(fences, 0, sizeof(fences));
+    memset(mapped, 0, sizeof(mapped));
+    upload = UPLOAD_DIRECT;
+}
+
+void SdlFrontend::shutdown()
+{
+    shutdown_upload();
+    if (texture)
+        glDeleteTextures(1, &texture);
+    texture = 0;
+    if (audio)
+        SDL_CloseAudioDevice(audio);
+    audio = 0;
+}
+
+// Uploads the span from the first to the last dirty row, the texture keeps the rest. No draw
+// call, the Screen window draws the texture as part of the ImGui frame
+void SdlFrontend::draw(const unsigned long long *display, unsigned int dirty_rows)
+{
+    if (!dirty_rows)
+        return;
+    int first = __builtin_ctz(dirty_rows);
+    int count = 32 - __builtin_clz(dirty_rows) - first;
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (upload == UPLOAD_DIRECT)
+    {
+        expand(display + first, count, pixels + first * 64, 1, off_colour, on_colour);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, 64, count, GL_RGBA, GL_UNSIGNED_BYTE, pixels + first * 64);
+    }
+    else
+    {
+        // The rows are expanded straight into the buffer and the copy into the texture runs on
+        // the GPU's time, while the next frame is emulated
+        int slot = pbo_next;
+        pbo_next = (pbo_next + 1) % PBO_RING;
+        gl.bind_buffer(GL_PIXEL_UNPACK_BUFFER, pbos[slot]);
+
+        unsigned int *dst;
+        if (upload == UPLOAD_PERSISTENT)
+        {
+            // The upload PBO_RING frames ago may still be reading this buffer
+            if (fences[slot])
+            {
+                GLsync fence = (GLsync)fences[slot];
+                if (gl.client_wait_sync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                {
+                    fence_waits++;
+                    gl.client_wait_sync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+                }
+                gl.delete_sync(fence);
+                fences[slot] = NULL;
+            }
+            dst = mapped[slot];
+        }
+        else
+        {
+            // A fresh store, the driver keeps the old one alive until its upload is done
+            gl.buffer_data(GL_PIXEL_UNPACK_BUFFER, FRAME_BYTES, NULL, GL_STREAM_DRAW);
+            dst = (unsigned int *)gl.map_buffer_range(GL_PIXEL_UNPACK_BUFFER, 0, FRAME_BYTES,
+                                                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        }
+
+        if (dst)
+        {
+            expand(display + first, count, dst + first * 64, 1, off_colour, on_colour);
+            if (upload == UPLOAD_ORPHAN)
+                gl.unmap_buffer(GL_PIXEL_UNPACK_BUFFER);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, 64, count, GL_RGBA, GL_UNSIGNED_BYTE,
+                            (const void *)(size_t)(first * 64 * 4));
+            if (upload == UPLOAD_PERSISTENT)
+                fences[slot] = gl.fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        gl.bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (!dst)
+        {
+            printf("mapping a pixel buffer failed, uploading frames directly\n");
+            shutdown_upload();
+            draw(display, dirty_rows);
+            return;
+        }
+    }
+    uploads++;
+    uploaded_rows += count;
+}
+
+void SdlFrontend::beep(bool on)
+{
+    if (on == beeping || !audio || clocked)
+        return;
+    beeping = on;
+    SDL_PauseAudioDevice(audio, on ? 0 : 1);
+}
+
+bool SdlFrontend::start_clock()
+{
+    if (!audio)
+        return false;
+    clocked = true;
+    SDL_PauseAudioDevice(audio, 0);
+    return true;
+}
+
+void SdlFrontend::queue_samples(int count, bool on)
+{
+    for (int i = 0; i < count; i++)
+        if (!samples.push(on ? square_wave(queue_phase, sample_rate) : 0))
+            return;
+}
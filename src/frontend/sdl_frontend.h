@@ -0,0 +1,96 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <atomic>
+#include "core/frontend.h"
+#include "core/expand_rgba.h"
+#include "spsc_queue.h"
+
+// CHIP-8 keys 0x0..0xF on the keyboard's 0-9 and A-F
+extern const SDL_Scancode keymap[0x10];
+
+// Samples the keyboard on the UI thread for a machine polling from another thread
+struct SdlInput : Input
+{
+    // Bit k set while key k is down
+    std::atomic<unsigned int> held;
+
+    SdlInput() : held(0) {}
+
+    // After SDL_PollEvent(), which is what updates the keyboard state
+    void capture();
+    void poll(unsigned char keys[16]);
+};
+
+// Pixel buffers in the ring, a frame's upload can still be in flight while the next two are written
+#define PBO_RING 3
+
+// How frames get into the texture, init() falls down the list to the first the driver supports
+enum UploadPath
+{
+    UPLOAD_PERSISTENT, // ring of persistently mapped buffers guarded by fences, needs ARB_buffer_storage
+    UPLOAD_ORPHAN,     // ring of buffers orphaned and mapped again every frame
+    UPLOAD_DIRECT,     // glTexSubImage2D straight from client memory
+    UPLOAD_PATH_COUNT
+};
+
+extern const char *upload_path_names[UPLOAD_PATH_COUNT];
+
+// Samples queued ahead of the audio device when it clocks the machine, about 46 ms at 44.1 kHz
+#define AUDIO_RING 2048
+
+// Uploads the display into a 64x32 texture for the Screen window and plays a square wave while
+// the sound timer runs. Once clocked, the device plays the samples the emulation thread queues
+// instead and never pauses
+struct SdlFrontend : Frontend
+{
+    // GL texture name, shown with ImGui::Image()
+    unsigned int texture;
+    ExpandRgba expand;
+    unsigned int pixels[64 * 32];
+    // RGBA in memory order, little endian words
+    unsigned int off_colour;
+    unsigned int on_colour;
+    // Frames that changed and the rows sent for them, for the Debug window
+    unsigned long long uploads;
+    unsigned long long uploaded_rows;
+
+    UploadPath upload;
+    unsigned int pbos[PBO_RING];
+    // Persistent path only, the mapping and the fence of the last upload from each buffer
+    unsigned int *mapped[PBO_RING];
+    void *fences[PBO_RING];
+    int pbo_next;
+    // Uploads that had to wait for the GPU to finish with a buffer
+    unsigned long long fence_waits;
+
+    SDL_AudioDeviceID audio;
+    int sample_rate;
+    unsigned int phase;
+    bool beeping;
+
+    // Set by start_clock() before the device starts, read by the audio callback
+    bool clocked;
+    SpscQueue<short, AUDIO_RING> samples;
+    // Samples the device took while clocked, silence it had to make up for an empty ring included
+    std::atomic<unsigned long long> played;
+    std::atomic<unsigned long long> underruns;
+    // The emulation thread's position in the square wave
+    unsigned int queue_phase;
+
+    // Creates the texture and the upload ring in the current GL context and opens the audio
+    // device, the frontend stays silent if there is none
+    bool init(UploadPath preferred = UPLOAD_PERSISTENT);
+    void shutdown();
+    // Releases the ring and goes back to UPLOAD_DIRECT
+    void shutdown_upload();
+
+    void draw(const unsigned long long *display, unsigned int dirty_rows);
+    void beep(bool on);
+
+    // Starts the device for good, from then on it plays only what queue_samples() sends.
+    // False without an audio device
+    bool start_clock();
+    // Emulation thread, count samples of the buzzer on or of silence. Drops what doesn't fit
+    void queue_samples(int count, bool on);
+};
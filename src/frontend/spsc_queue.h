@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+
+// Bounded queue from exactly one producer thread to exactly one consumer thread. Each side only
+// ever writes its own index, so push() and pop() are a load, a copy and a release store with no
+// locks. SIZE has to be a power of two, one slot stays empty to tell full from empty
+template <class T, int SIZE>
+struct SpscQueue
+{
+    static_assert((SIZE & (SIZE - 1)) == 0, "SpscQueue SIZE must be a power of two");
+
+    T slots[SIZE];
+    // Kept on separate cache lines so the two threads don't bounce one line between them
+    alignas(64) std::atomic<unsigned int> head; // next slot to pop, written by the consumer
+    alignas(64) std::atomic<unsigned int> tail; // next slot to push, written by the producer
+
+    SpscQueue() : head(0), tail(0) {}
+
+    // Producer side, false when the queue is full
+    bool push(const T &value)
+    {
+        unsigned int t = tail.load(std::memory_order_relaxed);
+        unsigned int next = (t + 1) & (SIZE - 1);
+        if (next == head.load(std::memory_order_acquire))
+            return false;
+        slots[t] = value;
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Entries waiting, from either side. The other side may be moving, so it's exact only as
+    // a bound: the producer may see fewer free slots and the consumer fewer entries than there are
+    unsigned int size() const
+    {
+        return (tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire)) & (SIZE - 1);
+    }
+
+    // Consumer side, false when the queue is empty
+    bool pop(T &value)
+    {
+        unsigned int h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        value = slots[h];
+        head.store((h + 1) & (SIZE - 1), std::memory_order_release);
+        return true;
+    }
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+
+// Hands the newest value from one writer thread to one reader thread without locks or waiting.
+// Each side owns one buffer and the third sits in the middle. The writer swaps its finished
+// buffer into the middle and the reader swaps the middle out when it's fresh, so neither ever
+// touches a buffer the other is using. The reader only ever sees the latest publish, values
+// published in between are dropped
+template <class T>
+struct TripleBuffer
+{
+    // Set in middle when the writer published since the reader last took it
+    static const int FRESH = 4;
+
+    T buffers[3];
+    std::atomic<int> middle;
+    int back;
+    int front;
+
+    TripleBuffer() : middle(1), back(0), front(2) {}
+
+    // Writer side, fill this and publish()
+    T &write_buffer()
+    {
+        return buffers[back];
+    }
+
+    void publish()
+    {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & 3;
+    }
+
+    // Reader side, takes the newest published buffer, false if there is nothing new
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+        return true;
+    }
+
+    const T &read_buffer() const
+    {
+        return buffers[front];
+    }
+};
@@ -2,374 +2,189 @@
 #include "imgui_impl_sdl.h"
 #include "imgui_impl_opengl3.h"
 #include <stdio.h>
+#include <stddef.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_opengl.h>
 #include "imgui_memory_editor.h"
+#include "core/chip8.h"
+#include "core/jit_x64.h"
+#include "frontend/sdl_frontend.h"
+#include "frontend/emu_thread.h"
 
-#define VX V[(opcode & 0x0F00) >> 8]
-#define VY V[(opcode & 0x00F0) >> 4]
-
-
-static int keymap[0x10] = {
-    SDLK_0,
-    SDLK_1,
-    SDLK_2,
-    SDLK_3,
-    SDLK_4,
-    SDLK_5,
-    SDLK_6,
-    SDLK_7,
-    SDLK_8,
-    SDLK_9,
-    SDLK_a,
-    SDLK_b,
-    SDLK_c,
-    SDLK_d,
-    SDLK_e,
-    SDLK_f
-};
-
-unsigned char chip8_fontset[80] =
-{
-    0xF0, 0x90, 0x90, 0x90, 0xF0, //0
-    0x20, 0x60, 0x20, 0x20, 0x70, //1
-    0xF0, 0x10, 0xF0, 0x80, 0xF0, //2
-    0xF0, 0x10, 0xF0, 0x10, 0xF0, //3
-    0x90, 0x90, 0xF0, 0x10, 0x10, //4
-    0xF0, 0x80, 0xF0, 0x10, 0xF0, //5
-    0xF0, 0x80, 0xF0, 0x90, 0xF0, //6
-    0xF0, 0x10, 0x20, 0x40, 0x40, //7
-    0xF0, 0x90, 0xF0, 0x90, 0xF0, //8
-    0xF0, 0x90, 0xF0, 0x10, 0xF0, //9
-    0xF0, 0x90, 0xF0, 0x90, 0x90, //A
-    0xE0, 0x90, 0xE0, 0x90, 0xE0, //B
-    0xF0, 0x80, 0x80, 0x80, 0xF0, //C
-    0xE0, 0x90, 0x90, 0x90, 0xE0, //D
-    0xF0, 0x80, 0xF0, 0x80, 0xF0, //E
-    0xF0, 0x80, 0xF0, 0x80, 0x80  //F
-};
-
-struct CHIP_8
-{
-    unsigned char memory[4 * 1024];
-    unsigned char display[64 * 32];
-    unsigned char key[16];
-
-    unsigned short pc;
-    unsigned short opcode;
-    unsigned short I;
-    unsigned short sp;
+// Edits from the memory editors are queued for the emulation thread and show up after its next batch
+static EmuThread *editing = NULL;
 
-    unsigned char V[16];
+static void write_memory(ImU8 *data, size_t off, ImU8 d)
+{
+    editing->send(COMMAND_POKE, (int)off, d);
+}
 
-    unsigned short stack[16];
+// The display editor shows 8 bytes per row from the left edge, whatever the host's byte order.
+// Byte off % 8 of row off / 8 holds pixels off % 8 * 8 to off % 8 * 8 + 7, MSB first
+static ImU8 read_display(const ImU8 *data, size_t off)
+{
+    const unsigned long long *rows = (const unsigned long long *)data;
+    return rows[off / 8] >> (56 - off % 8 * 8) & 0xFF;
+}
 
-    unsigned char delay_timer;
-    unsigned char sound_timer;
+static void write_display(ImU8 *data, size_t off, ImU8 d)
+{
+    editing->send(COMMAND_POKE_DISPLAY, (int)off, d);
+}
 
-    void clear_display()
+// MemoryEditor::DrawWindow() that tells whether the window is visible, a collapsed editor
+// doesn't need snapshots. Until the first one arrives there is nothing to show
+static bool draw_editor(MemoryEditor &editor, const char *title, bool *open, void *data, size_t size, bool ready)
+{
+    bool visible = ImGui::Begin(title, open, ImGuiWindowFlags_NoScrollbar);
+    if (visible)
     {
-        memset(display, 0, 64 * 32);
+        if (!ready)
+            ImGui::Text("Waiting for the machine...");
+        else
+        {
+            if (ImGui::IsWindowHovered(ImGuiHoveredFlags_RootAndChildWindows) && ImGui::IsMouseReleased(ImGuiMouseButton_Right))
+                ImGui::OpenPopup("context");
+            editor.DrawContents(data, size, 0);
+        }
     }
+    ImGui::End();
+    return visible;
+}
 
-    void tick()
+// Runs every rom headless for a fixed number of cycles on each engine and prints instructions per second
+static int run_benchmark(const char **roms, int rom_count, long long cycles, bool jit_check, Platform platform)
+{
+    printf("%-24s %-10s %14s %10s\n", "rom", "engine", "ips", "speedup");
+    for (int r = 0; r < rom_count; r++)
     {
-        opcode = memory[pc] << 8 | memory[pc + 1];
-
-        switch (opcode & 0xF000)
-        {
-        case 0x0000:
-        {
-            switch (opcode & 0x000F)
-            {
-            case 0x0000: // 00E0 Clear Display
-                clear_display();
-                pc += 2;
-                break;
-            case 0x000E: // 000EE return from sub routine
-                pc = stack[(--sp) & 0xF] + 2;
-                break;
-            }
-        }
-        break;
-
-        case 0x1000: // 1NNN Jump to address NNN
-            pc = opcode & 0x0FFF;
-            break;
-
-        case 0x2000:                  // 2NNN Call subroutine at NNN
-            stack[(sp++) & 0xF] = pc; // push pc onto stack and increment sp
-            pc = opcode & 0x0FFF;
-            break;
-
-        case 0x3000: // 3XNN skip the next instruction if VX == NN
-            if (V[(opcode & 0x0F00) >> 8] == (opcode & 0x00FF))
-                pc += 4;
-            else
-                pc += 2;
-            break;
-
-        case 0x4000: // 4XNN skip the next instruction if VX != NN
-            if (V[(opcode & 0x0F00) >> 8] != (opcode & 0x00FF))
-                pc += 4;
-            else
-                pc += 2;
-            break;
-
-        case 0x5000: // 5XY0 skip the next instruction if VX == VY
-            if (V[(opcode & 0x0F00) >> 8] == V[(opcode & 0x00F0) >> 4])
-                pc += 4;
-            else
-                pc += 2;
-            break;
-
-        case 0x6000: // 6XNN set VX to NN
-            V[(opcode & 0xF00) >> 8] = (opcode & 0x00FF);
-            pc += 2;
-            break;
-
-        case 0x7000: // 7XNN add NN to VX
-            V[(opcode & 0xF00) >> 8] += (opcode & 0x00FF);
-            pc += 2;
-            break;
-
-        case 0x8000:
-            switch (opcode & 0x000F)
-            {
-            case 0x0000: // 8XY0 set VX = VY
-                VX = VY;
-                pc += 2;
-                break;
-            case 0x0001: // 8XY1 set VX = VX | VY
-                VX = VX | VY;
-                pc += 2;
-                break;
-            case 0x0002: // 8XY2 set VX = VX & VY
-                VX = VX & VY;
-                pc += 2;
-                break;
-            case 0x0003: // 8XY1 set VX = VX ^ VY
-                VX = VX ^ VY;
-                pc += 2;
-                break;
-            case 0x0004: // 8XY4 set VX += VY
-                if ((int)VX + (int)VY < 256)
-                    V[0xF] &= 0;
-                else
-                    V[0xF] = 1;
-                VX += VY;
-                pc += 2;
-                break;
-            case 0x0005: // 8XY5 set VX -= VY
-                if ((int)VX - (int)VY >= 0)
-                    V[0xF] = 1;
-                else
-                    V[0xF] &= 0;
-                VX -= VY;
-                pc += 2;
-                break;
-            case 0x0006: // 8XY6 VX >>= 1
-                V[0xF] = VX & 7;
-                VX = VX >> 1;
-                pc += 2;
-                break;
-            case 0x0007: // 8XY7 VX = VY - VX
-                if ((int)VX - (int)VY > 0)
-                    V[0xF] = 1;
-                else
-                    V[0xF] &= 0;
-                VX = VY - VX;
-                pc += 2;
-                break;
-            case 0x000E:
-                V[0xF] = VX & 7;
-                VX = VX << 1;
-                pc += 2;
-                break;
-            }
-            break;
-
-        case 0x9000: // 9XY0 skip the next instruction if VX != VY
-            if (V[(opcode & 0x0F00) >> 8] != V[(opcode & 0x00F0) >> 4])
-                pc += 4;
-            else
-                pc += 2;
-            break;
-
-        case 0xA000: // ANNN set I to address NNN
-            I = (opcode & 0x0FFF);
-            pc += 2;
-            break;
-
-        case 0xB000: // BNNN jump to address NNN + V0
-            pc = (opcode & 0x0FFF) + V[0];
-            pc += 2;
-            break;
-
-        case 0xC000: // CXNN sets VX to random number & NN
-            V[(opcode & 0x0F00) >> 8] = rand() & (opcode & 0x00FF);
-            pc += 2;
-            break;
-
-        case 0xD000: // DXYN Draw a sprite at (VX, VY) width 8 and height of N pixels
+        double baseline = 0.0;
+        for (int e = 0; e < ENGINE_COUNT; e++)
         {
-            int vx = V[(opcode & 0x0F00) >> 8];
-            int vy = V[(opcode & 0x00F0) >> 4];
-            int height = (opcode & 0x000F);
-            V[0xF] &= 0;
+            CHIP_8 *chip = new CHIP_8();
+            chip->restart();
+            chip->loadfile(roms[r], platform);
 
-            for (int y = 0; y < height; ++y)
+            JIT_X64 *jit = NULL;
+            if (e == ENGINE_JIT || e == ENGINE_TRACE)
             {
-                int pixel = memory[I + y];
-                for (int x = 0; x < 8; ++x)
-                {
-                    if (pixel & (0x80 >> x))
-                    {
-                        if (display[x + vx + (y + vy) * 64])
-                        {
-                            V[0xF] = 1;
-                        }
-                        display[x + vx + (y + vy) * 64] ^= 1;
-                    }
-                }
+                jit = new JIT_X64();
+                jit->init();
+                jit->cross_check = jit_check;
+                chip->jit = jit;
             }
-            pc += 2;
-        }
-        break;
 
-        case 0xE000:
-            switch (opcode & 0x000F)
+            unsigned long long start = chip8_clock();
+            for (long long done = 0; done < cycles; done += 1000)
+                chip->execute((Engine)e, 1000);
+            double seconds = (double)(chip8_clock() - start) / 1e9;
+
+            double ips = cycles / seconds;
+            if (e == 0)
+                baseline = ips;
+            printf("%-24s %-10s %14.0f %9.2fx\n", roms[r], engine_names[e], ips, ips / baseline);
+
+            if (chip->idle_skipped)
+                printf("    %llu instructions skipped in idle loops\n", chip->idle_skipped);
+            if (e == ENGINE_OPCODE && !CHIP8_OPCODE_TABLE)
+                printf("    built without CHIP8_OPCODE_TABLE, ran on the switch engine\n");
+            if (e == ENGINE_AOT && !chip->aot)
+                printf("    no chip8-aot translation built in, ran on the predecoded engine\n");
+            if (jit && e == ENGINE_JIT)
+                printf("    %llu blocks, %llu native / %llu interpreted instructions, %llu flushes, %llu mismatches\n",
+                       jit->stats.blocks_compiled, jit->stats.native_instructions, jit->stats.interpreted_instructions,
+                       jit->stats.flushes, jit->stats.mismatches);
+            if (jit && e == ENGINE_TRACE)
             {
-            case 0x000E: // EX9E: Skips the next instruction if the key stored in VX is pressed
-                {
-
-                const unsigned char* keys = SDL_GetKeyboardState(NULL);
-                if (keys[keymap[V[(opcode & 0x0F00) >> 8]]])
-                    pc += 4;
-                else
-                    pc += 2;
-                }
-                break;
-
-            case 0x0001: // EXA1: Skips the next instruction if the key stored in VX isn't pressed
-                {
-                const unsigned char* keys = SDL_GetKeyboardState(NULL);
-                    
-                if (!keys[keymap[V[(opcode & 0x0F00) >> 8]]])
-                    pc += 4;
-                else
-                    pc += 2;
-                }
-                break;
+                const JitStats &s = jit->stats;
+                printf("    %llu traces (%llu aborted), %llu native / %llu interpreted instructions\n",
+                       s.traces_compiled, s.traces_aborted, s.native_instructions, s.interpreted_instructions);
+                printf("    %llu entries, %llu linked, %llu exits to the interpreter (%llu side exits), %.1f instructions per exit\n",
+                       s.trace_entries, s.trace_entries > s.trace_runs ? s.trace_entries - s.trace_runs : 0, s.trace_runs, s.side_exits,
+                       s.trace_runs ? (double)s.native_instructions / s.trace_runs : 0.0);
             }
-            break;
-        case 0xF000:
-            switch (opcode & 0x00FF)
+            if (jit)
             {
-            case 0x0007: // FX07: Sets VX to the value of the delay timer
-                V[(opcode & 0x0F00) >> 8] = delay_timer;
-                pc += 2;
-                break;
-
-            case 0x000A: // FX0A: A key press is awaited, and then stored in VX
-                {
-
-                const unsigned char* keys = SDL_GetKeyboardState(NULL);
-                for (int i = 0; i < 0x10; i++)
-                    if (keys[keymap[i]])
-                    {
-                        V[(opcode & 0x0F00) >> 8] = i;
-                        pc += 2;
-                    }
-                }
-                break;
-
-            case 0x0015: // FX15: Sets the delay timer to VX
-                delay_timer = V[(opcode & 0x0F00) >> 8];
-                pc += 2;
-                break;
-
-            case 0x0018: // FX18: Sets the sound timer to VX
-                sound_timer = V[(opcode & 0x0F00) >> 8];
-                pc += 2;
-                break;
-
-            case 0x001E: // FX1E: Adds VX to I
-                I += V[(opcode & 0x0F00) >> 8];
-                pc += 2;
-                break;
-
-            case 0x0029: // FX29: Sets I to the location of the sprite for the character in VX. Characters 0-F (in hexadecimal) are represented by a 4x5 font
-                I = V[(opcode & 0x0F00) >> 8] * 5;
-                pc += 2;
-                break;
-
-            case 0x0033: // FX33: Stores the Binary-coded decimal representation of VX, with the most significant of three digits at the address in I, the middle digit at I plus 1, and the least significant digit at I plus 2
-                memory[I] = V[(opcode & 0x0F00) >> 8] / 100;
-                memory[I + 1] = (V[(opcode & 0x0F00) >> 8] / 10) % 10;
-                memory[I + 2] = V[(opcode & 0x0F00) >> 8] % 10;
-                pc += 2;
-                break;
-
-            case 0x0055: // FX55: Stores V0 to VX in memory starting at address I
-                for (int i = 0; i <= ((opcode & 0x0F00) >> 8); i++)
-                    memory[I + i] = V[i];
-                pc += 2;
-                break;
-
-            case 0x0065: //FX65: Fills V0 to VX with values from memory starting at address I
-                for (int i = 0; i <= ((opcode & 0x0F00) >> 8); i++)
-                    V[i] = memory[I + i];
-                pc += 2;
-                break;
+                jit->shutdown();
+                delete jit;
             }
-            break;
+            delete chip;
         }
-
-        if(delay_timer > 0)
-            delay_timer--;
-        if(sound_timer > 0)
-            sound_timer--;
     }
+    return 0;
+}
 
-    void restart()
+int main(int argc, char **argv)
+{
+    build_op_table();
+
+    Engine engine = ENGINE_BATCH;
+    // See CHIP_8::loadfile(), --platform schip gives the quirks the emulator had before the presets
+    Platform platform = PLATFORM_VIP;
+    UploadPath upload = UPLOAD_PERSISTENT;
+    bool bench = false;
+    bool jit_check = false;
+    long long bench_cycles = 10000000;
+    int speed = CHIP8_DEFAULT_SPEED;
+    Pacing pacing = PACE_COUNTER;
+    const char *bench_roms[16];
+    int bench_rom_count = 0;
+
+    for (int i = 1; i < argc; i++)
     {
-        pc = 0x200;
-        I = 0;
-        opcode = 0;
-        sp = 0;
-        // unsigned char memory[4 * 1024];
-        clear_display();
-        memset(key, 0, 16);
-        memset(V, 0, 16);
-        memset(stack, 0, sizeof(unsigned short) * 16);
-        delay_timer = 60;
-        sound_timer = 60;
-
-        for (int i = 0; i < 80; ++i)
+        if (!strcmp(argv[i], "--engine") && i + 1 < argc)
+        {
+            i++;
+            for (int e = 0; e < ENGINE_COUNT; e++)
+                if (!strcmp(argv[i], engine_names[e]))
+                    engine = (Engine)e;
+        }
+        else if (!strcmp(argv[i], "--platform") && i + 1 < argc)
+        {
+            i++;
+            for (int p = 0; p < PLATFORM_COUNT; p++)
+                if (!strcmp(argv[i], platform_names[p]))
+                    platform = (Platform)p;
+        }
+        else if (!strcmp(argv[i], "--upload") && i + 1 < argc)
+        {
+            i++;
+            for (int u = 0; u < UPLOAD_PATH_COUNT; u++)
+                if (!strcmp(argv[i], upload_path_names[u]))
+                    upload = (UploadPath)u;
+        }
+        else if (!strcmp(argv[i], "--bench"))
+            bench = true;
+        else if (!strcmp(argv[i], "--jit-check"))
+            jit_check = true;
+        else if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+            bench_cycles = atoll(argv[++i]);
+        else if (!strcmp(argv[i], "--speed") && i + 1 < argc)
+            speed = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--pace") && i + 1 < argc)
         {
-            memory[i] = chip8_fontset[i];
+            i++;
+            for (int p = 0; p < PACING_COUNT; p++)
+                if (!strcmp(argv[i], pacing_names[p]))
+                    pacing = (Pacing)p;
         }
+        else if (bench_rom_count < 16)
+            bench_roms[bench_rom_count++] = argv[i];
     }
 
-    void loadfile(const char *file_path)
+    if (bench)
     {
-        FILE *file = fopen(file_path, "rb");
-        if (!file)
+        if (bench_rom_count == 0)
         {
-            printf("failed to load %s into memory!\n", file_path);
-            return;
+            bench_roms[bench_rom_count++] = "./roms/ibm_logo.ch8";
+            bench_roms[bench_rom_count++] = "./roms/life.ch8";
+            bench_roms[bench_rom_count++] = "./roms/maze.ch8";
+            bench_roms[bench_rom_count++] = "./roms/pong.ch8";
         }
-
-        fread(memory + 0x200, 1, (4 * 1024) - 0x200, file);
-
-        fclose(file);
+        return run_benchmark(bench_roms, bench_rom_count, bench_cycles, jit_check, platform);
     }
-};
 
-int main(int argc, char **argv)
-{
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) != 0)
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) != 0)
     {
         printf("Error: %s\n", SDL_GetError());
         return -1;
@@ -416,23 +231,46 @@ int main(int argc, char **argv)
 
     CHIP_8 chip = {};
 
+    SdlInput input;
+    SdlFrontend frontend = {};
+    frontend.init(upload);
+    chip.input = &input;
+
+    JIT_X64 jit = {};
+    if ((engine == ENGINE_JIT || engine == ENGINE_TRACE) && jit.init())
+    {
+        jit.cross_check = jit_check;
+        chip.jit = &jit;
+    }
+
+    chip.seed_random(SDL_GetPerformanceCounter());
     chip.restart();
-    chip.loadfile("./roms/pong.ch8");
+    chip.loadfile("./roms/pong.ch8", platform);
 
     ImVec4 clear_color = {};
 
     MemoryEditor memoryEditor;
+    memoryEditor.WriteFn = write_memory;
     MemoryEditor stackEditor;
     MemoryEditor displayEditor;
-
-    glMatrixMode(GL_PROJECTION_MATRIX);
-    glLoadIdentity();
-    glOrtho(0, 640, 480, 0, -1, 1);
-
-    bool step = true;
-    bool debug = false;
+    displayEditor.ReadFn = read_display;
+    displayEditor.WriteFn = write_display;
+
+    EmuThread emu;
+    emu.start(&chip, engine, &frontend, speed, pacing);
+    printf("F1 shows the Debug window\n");
+    editing = &emu;
+    // Sequence of the last frame uploaded
+    unsigned long long shown = 0;
+
+    int breakpoint = 0x200;
+    char rom[256] = "./roms/pong.ch8";
     bool display = false;
     bool memory = false;
+    // Off until F1, snapshots cost nothing while no debug window is visible
+    bool debug = false;
+    // Set once the first snapshot arrived
+    bool inspected = false;
 
     while (running)
     {
@@ -452,10 +290,14 @@ int main(int argc, char **argv)
                 case SDL_SCANCODE_ESCAPE:
                     running = false;
                     break;
+                case SDL_SCANCODE_F1:
+                    debug = !debug;
+                    break;
                 }
                 break;
             }
         }
+        input.capture();
 
         glClear(GL_COLOR_BUFFER_BIT);
         glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w, clear_color.z * clear_color.w, clear_color.w);
@@ -465,91 +307,142 @@ int main(int argc, char **argv)
         ImGui_ImplSDL2_NewFrame();
         ImGui::NewFrame();
 
-        for (int y = 0; y < 32; y++)
+        // Only the newest frame is uploaded. After a skipped one the changed rows are unknown
+        if (emu.frames.update())
         {
-            for (int x = 0; x < 64; x++)
-            {
-                if (chip.display[(y * 64) + x] == 1)
-                {
-                    glBegin(GL_QUADS);
-                    glVertex2f(x * 10, y * 15);
-                    glVertex2f(x * 10, y * 15 + 15);
-                    glVertex2f(x * 10 + 10, y * 15 + 15);
-                    glVertex2f(x * 10 + 10, y * 15);
-                    glEnd();
-                }
-            }
+            const Frame &frame = emu.frames.read_buffer();
+            frontend.draw(frame.display, frame.sequence == shown + 1 ? frame.dirty_rows : ~0u);
+            shown = frame.sequence;
         }
 
+        // The display scaled to the window at 2:1, pixels stay square
+        ImGui::Begin("Screen");
+        ImVec2 room = ImGui::GetContentRegionAvail();
+        float width = room.x < room.y * 2.0f ? room.x : room.y * 2.0f;
+        ImGui::Image((ImTextureID)(intptr_t)frontend.texture, ImVec2(width, width / 2.0f));
+        ImGui::End();
+
+        // The debug windows draw the machine as of the last snapshot and change it through
+        // emu.send(), they never touch chip while the emulation thread runs it
+        if (emu.snapshots.update())
+            inspected = true;
+        // The memory editor only writes through WriteFn, never into the snapshot itself
+        DebugState &state = const_cast<DebugState &>(emu.snapshots.read_buffer());
+        bool inspecting = false;
+
         if (memory)
         {
-            memoryEditor.DrawWindow("Memory", chip.memory, 4 * 1024, (size_t)0);
+            inspecting |= draw_editor(memoryEditor, "Memory", &memory, state.memory, 4 * 1024, inspected);
         }
         // stackEditor.Cols = 2;
         // stackEditor.PreviewDataType = ImGuiDataType_U16;
-        // stackEditor.DrawWindow("Stack",chip.stack, sizeof(unsigned short) * 16, (size_t)0);
+        // stackEditor.DrawWindow("Stack",state.stack, sizeof(unsigned short) * 16, (size_t)0);
         if (display)
         {
-            displayEditor.Cols = 64;
+            // A row per line, left to right like the Screen window
+            displayEditor.Cols = 8;
             displayEditor.OptShowAscii = false;
-            displayEditor.DrawWindow("Display Memory", chip.display, sizeof(unsigned char) * 32 * 64, 0);
+            inspecting |= draw_editor(displayEditor, "Display Memory", &display, state.display, sizeof(state.display), inspected);
         }
 
-        ImGui::Begin("Debug");
-        ImGui::Text("PC: %d", chip.pc);
-        ImGui::Text("I: %d", chip.I);
-        ImGui::Text("OpCode: %x", chip.opcode);
-        ImGui::Text("SP: %d", chip.sp);
-        ImGui::Text("V0: %d", chip.V[0x0]);
-        ImGui::Text("V1: %d", chip.V[0x1]);
-        ImGui::Text("V2: %d", chip.V[0x2]);
-        ImGui::Text("V3: %d", chip.V[0x3]);
-        ImGui::Text("V4: %d", chip.V[0x4]);
-        ImGui::Text("V5: %d", chip.V[0x5]);
-        ImGui::Text("V6: %d", chip.V[0x6]);
-        ImGui::Text("V7: %d", chip.V[0x7]);
-        ImGui::Text("V8: %d", chip.V[0x8]);
-        ImGui::Text("V9: %d", chip.V[0x9]);
-        ImGui::Text("VA: %d", chip.V[0xA]);
-        ImGui::Text("VB: %d", chip.V[0xB]);
-        ImGui::Text("VC: %d", chip.V[0xC]);
-        ImGui::Text("VD: %d", chip.V[0xD]);
-        ImGui::Text("VE: %d", chip.V[0xE]);
-        ImGui::Text("VF: %d", chip.V[0xF]);
-
-        if (ImGui::Button("Step"))
+        // F1 brings it back after it's closed. Collapsed it counts as hidden. show is latched
+        // because the close button clears debug inside Begin(), End() is owed either way
+        bool show = debug;
+        if (show)
         {
-            step = true;
-        }
+            if (ImGui::Begin("Debug", &debug))
+            {
+                inspecting = true;
+                if (!inspected)
+                {
+                    ImGui::Text("Waiting for the machine...");
+                }
+                else
+                {
+                    ImGui::Text("PC: %d", state.pc);
+                    ImGui::Text("I: %d", state.I);
+                    ImGui::Text("OpCode: %x", state.opcode);
+                    ImGui::Text("SP: %d", state.sp);
+                    ImGui::Text("DT: %d", state.delay);
+                    ImGui::Text("ST: %d", state.sound);
+                    ImGui::Text("V0: %d", state.V[0x0]);
+                    ImGui::Text("V1: %d", state.V[0x1]);
+                    ImGui::Text("V2: %d", state.V[0x2]);
+                    ImGui::Text("V3: %d", state.V[0x3]);
+                    ImGui::Text("V4: %d", state.V[0x4]);
+                    ImGui::Text("V5: %d", state.V[0x5]);
+                    ImGui::Text("V6: %d", state.V[0x6]);
+                    ImGui::Text("V7: %d", state.V[0x7]);
+                    ImGui::Text("V8: %d", state.V[0x8]);
+                    ImGui::Text("V9: %d", state.V[0x9]);
+                    ImGui::Text("VA: %d", state.V[0xA]);
+                    ImGui::Text("VB: %d", state.V[0xB]);
+                    ImGui::Text("VC: %d", state.V[0xC]);
+                    ImGui::Text("VD: %d", state.V[0xD]);
+                    ImGui::Text("VE: %d", state.V[0xE]);
+                    ImGui::Text("VF: %d", state.V[0xF]);
+                    ImGui::Text("Engine: %s", engine_names[engine]);
+                    ImGui::Text("Platform: %s", platform_names[state.platform]);
+                    ImGui::Text("Screen: %s, %llu uploads, %llu rows, %llu fence waits", upload_path_names[frontend.upload],
+                                frontend.uploads, frontend.uploaded_rows, frontend.fence_waits);
+                    ImGui::Text("Frames: %llu published, %llu shown", state.published, shown);
+                    ImGui::Text("Speed: %d ips, %llu instructions dropped", state.speed, state.dropped);
+                    ImGui::Text("Pacing: %s", pacing_names[emu.pacing]);
+                    if (emu.pacing == PACE_AUDIO)
+                        ImGui::Text("Audio: %u of %d samples queued, %llu underrun", frontend.samples.size(), AUDIO_RING,
+                                    frontend.underruns.load());
+                    if (state.jit)
+                        ImGui::Text("JIT: %llu blocks, %llu traces, %llu native, %llu interpreted", state.jit_stats.blocks_compiled, state.jit_stats.traces_compiled, state.jit_stats.native_instructions, state.jit_stats.interpreted_instructions);
+
+                    ImGui::Text("Last run: %s", run_result_names[state.last_run]);
+
+                    bool paused = state.paused;
+                    if (ImGui::Checkbox("Pause", &paused))
+                    {
+                        emu.send(COMMAND_PAUSE, 0, paused);
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button("Step"))
+                    {
+                        emu.send(COMMAND_STEP, 0, 1);
+                    }
 
-        if (ImGui::Button("Restart"))
-        {
-            chip.restart();
-        }
+                    ImGui::InputInt("Breakpoint", &breakpoint, 2, 16, ImGuiInputTextFlags_CharsHexadecimal);
+                    breakpoint &= 0xFFF;
+                    ImGui::SameLine();
+                    if (ImGui::Button(state.breakpoints[breakpoint] ? "Clear" : "Set"))
+                    {
+                        emu.send(COMMAND_BREAKPOINT, breakpoint, !state.breakpoints[breakpoint]);
+                    }
+
+                    if (ImGui::InputInt("Speed", &speed, 100, 1000, ImGuiInputTextFlags_EnterReturnsTrue))
+                    {
+                        speed = speed < 60 ? 60 : speed;
+                        emu.send(COMMAND_SPEED, 0, speed);
+                    }
 
-        ImGui::Checkbox("Show Memory Editor", &memory);
-        ImGui::Checkbox("Show Display Editor", &display);
+                    ImGui::InputText("ROM", rom, sizeof(rom));
+                    ImGui::SameLine();
+                    if (ImGui::Button("Load"))
+                    {
+                        emu.send(COMMAND_LOAD_ROM, 0, 0, rom);
+                    }
 
-        ImGui::End();
+                    if (ImGui::Button("Restart"))
+                    {
+                        emu.send(COMMAND_RESTART);
+                    }
 
-        if (debug)
-        {
-            if (step)
-            {
-                chip.tick();
-                step = false;
-            }
-        }
-        else
-        {
-            for (int i = 0; i < 10; i++)
-            {
-                /* code */
-                chip.tick();
+                    ImGui::Checkbox("Show Memory Editor", &memory);
+                    ImGui::Checkbox("Show Display Editor", &display);
+                }
             }
-            
+            ImGui::End();
         }
 
+        // Snapshots are only copied while something above shows them
+        emu.inspect = inspecting;
+
         ImGui::Render();
         glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -566,6 +459,10 @@ int main(int argc, char **argv)
         SDL_GL_SwapWindow(window);
     }
 
+    emu.stop();
+    jit.shutdown();
+    frontend.shutdown();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
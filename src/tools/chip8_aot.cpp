@@ -0,0 +1,453 @@
+// chip8-aot: translates a rom into a C++ translation unit for the aot engine
+//
+//   chip8-aot [--platform vip|chip48|schip|xochip] <rom> <output.cpp> [name]
+//
+// The quirks of the platform are baked into the generated code, the aot engine only picks the
+// translation up when the rom is loaded for the same platform. The default is vip
+// Control flow is discovered from 0x200, every reachable basic block becomes a label and
+// direct jumps, calls and skips become gotos. 00EE and BNNN go through a switch on pc,
+// anything that wasn't discovered, FX0A and invalid opcodes run through CHIP_8::tick()
+
+#include <stdio.h>
+#include <string.h>
+#include "core/chip8.h"
+
+// Keeps the budget check per block cheap while still letting small slices run native code
+#define MAX_BLOCK_LENGTH 32
+
+struct Translator
+{
+    unsigned char memory[4 * 1024];
+    int rom_end;
+
+    bool reachable[4 * 1024];
+    bool leader[4 * 1024];
+    bool translated[4 * 1024];
+
+    int worklist[4 * 1024];
+    int pending;
+
+    FILE *out;
+
+    Platform platform;
+    QuirkFlags quirks;
+
+    bool in_rom(int addr) { return addr >= 0x200 && addr + 1 < rom_end; }
+
+    Instruction at(int addr) { return decode(memory[addr] << 8 | memory[addr + 1]); }
+
+    void visit(int addr, bool is_leader)
+    {
+        if (!in_rom(addr))
+            return;
+        if (is_leader)
+            leader[addr] = true;
+        if (!reachable[addr])
+        {
+            reachable[addr] = true;
+            worklist[pending++] = addr;
+        }
+    }
+
+    void discover()
+    {
+        visit(0x200, true);
+        while (pending > 0)
+        {
+            int addr = worklist[--pending];
+            Instruction ins = at(addr);
+            switch (ins.op)
+            {
+            case OP_INVALID:
+            case OP_00EE:
+            case OP_BNNN:
+                break;
+            case OP_1NNN:
+                visit(ins.nnn, true);
+                break;
+            case OP_2NNN:
+                visit(ins.nnn, true);
+                visit(addr + 2, true);
+                break;
+            case OP_3XNN:
+            case OP_4XNN:
+            case OP_5XY0:
+            case OP_9XY0:
+            case OP_EX9E:
+            case OP_EXA1:
+                visit(addr + 2, true);
+                visit(addr + 4, true);
+                break;
+            // Stores may hit code, the block ends so the check after them is once per block
+            case OP_FX0A:
+            case OP_FX33:
+            case OP_FX55:
+                visit(addr + 2, true);
+                break;
+            default:
+                visit(addr + 2, false);
+                break;
+            }
+        }
+    }
+
+    static bool translatable(int op) { return op != OP_INVALID && op != OP_FX0A; }
+
+    // pc and cycles are already known at compile time, the cycle count is settled once per exit
+    void settle(int ticks, unsigned short opcode)
+    {
+        if (ticks > 0)
+            fprintf(out, "    c.cycle += %d;\n", ticks);
+        fprintf(out, "    c.opcode = 0x%04X;\n", opcode);
+    }
+
+    void jump(int target, const char *indent = "    ")
+    {
+        if (in_rom(target) && leader[target])
+            fprintf(out, "%sgoto b_%03X;\n", indent, target);
+        else
+            fprintf(out, "%sc.pc = 0x%03X;\n%sgoto dispatch;\n", indent, target, indent);
+    }
+
+    void straight(const Instruction &ins)
+    {
+        int x = ins.x, y = ins.y;
+        switch (ins.op)
+        {
+        case OP_00E0:
+            fprintf(out, "    c.clear_display();\n");
+            break;
+        case OP_6XNN:
+            fprintf(out, "    c.V[0x%X] = 0x%02X;\n", x, ins.nn);
+            break;
+        case OP_7XNN:
+            fprintf(out, "    c.V[0x%X] += 0x%02X;\n", x, ins.nn);
+            break;
+        case OP_8XY0:
+            fprintf(out, "    c.V[0x%X] = c.V[0x%X];\n", x, y);
+            break;
+        case OP_8XY1:
+        case OP_8XY2:
+        case OP_8XY3:
+            fprintf(out, "    c.V[0x%X] %s= c.V[0x%X];\n", x, ins.op == OP_8XY1 ? "|" : ins.op == OP_8XY2 ? "&" : "^", y);
+            if (quirks.vf_reset)
+                fprintf(out, "    c.V[0xF] = 0;\n");
+            break;
+        // VF is written before the result, like CHIP_8::tick()
+        case OP_8XY4:
+            fprintf(out, "    c.V[0xF] = c.V[0x%X] + c.V[0x%X] > 255;\n    c.V[0x%X] += c.V[0x%X];\n", x, y, x, y);
+            break;
+        case OP_8XY5:
+            fprintf(out, "    c.V[0xF] = c.V[0x%X] >= c.V[0x%X];\n    c.V[0x%X] -= c.V[0x%X];\n", x, y, x, y);
+            break;
+        // The flag is the bit shifted out and written after the result
+        case OP_8XY6:
+            fprintf(out, "    {\n        unsigned char source = c.V[0x%X];\n", quirks.shift_vy ? y : x);
+            fprintf(out, "        c.V[0x%X] = source >> 1;\n        c.V[0xF] = source & 1;\n    }\n", x);
+            break;
+        case OP_8XY7:
+            fprintf(out, "    c.V[0xF] = c.V[0x%X] > c.V[0x%X];\n    c.V[0x%X] = c.V[0x%X] - c.V[0x%X];\n", x, y, x, y, x);
+            break;
+        case OP_8XYE:
+            fprintf(out, "    {\n        unsigned char source = c.V[0x%X];\n", quirks.shift_vy ? y : x);
+            fprintf(out, "        c.V[0x%X] = source << 1;\n        c.V[0xF] = source >> 7;\n    }\n", x);
+            break;
+        case OP_ANNN:
+            fprintf(out, "    c.I = 0x%03X;\n", ins.nnn);
+            break;
+        case OP_CXNN:
+            fprintf(out, "    c.V[0x%X] = c.random() & 0x%02X;\n", x, ins.nn);
+            break;
+        case OP_DXYN:
+            fprintf(out, "    c.draw_sprite(c.V[0x%X], c.V[0x%X], %d);\n", x, y, ins.n);
+            break;
+        case OP_FX07:
+            fprintf(out, "    c.V[0x%X] = c.delay();\n", x);
+            break;
+        case OP_FX15:
+            fprintf(out, "    c.set_delay(c.V[0x%X]);\n", x);
+            break;
+        case OP_FX18:
+            fprintf(out, "    c.set_sound(c.V[0x%X]);\n", x);
+            break;
+        case OP_FX1E:
+            fprintf(out, "    c.I += c.V[0x%X];\n", x);
+            break;
+        case OP_FX29:
+            fprintf(out, "    c.I = c.V[0x%X] * 5;\n", x);
+            break;
+        case OP_FX33:
+            fprintf(out, "    c.store_bcd(0x%X);\n", x);
+            break;
+        case OP_FX55:
+            fprintf(out, "    c.store_registers(0x%X);\n", x);
+            if (load_store_advance(quirks.load_store_i, x))
+                fprintf(out, "    c.I += %d;\n", load_store_advance(quirks.load_store_i, x));
+            break;
+        case OP_FX65:
+            fprintf(out, "    for (int i = 0; i <= 0x%X; i++)\n        c.V[i] = c.memory[(c.I + i) & 0xFFF];\n", x);
+            if (load_store_advance(quirks.load_store_i, x))
+                fprintf(out, "    c.I += %d;\n", load_store_advance(quirks.load_store_i, x));
+            break;
+        default:
+            break;
+        }
+    }
+
+    static bool reads_timers(int op) { return op == OP_FX07 || op == OP_FX15 || op == OP_FX18; }
+
+    // Emits the block at start, false if its first instruction is left to the interpreter
+    bool block(int start)
+    {
+        int length = 0;
+        int addr = start;
+        while (length < MAX_BLOCK_LENGTH && in_rom(addr) && translatable(at(addr).op) && (addr == start || !leader[addr]))
+        {
+            Instruction ins = at(addr);
+            length++;
+            addr += 2;
+            if (ins.op == OP_00EE || ins.op == OP_1NNN || ins.op == OP_2NNN || ins.op == OP_BNNN ||
+                ins.op == OP_3XNN || ins.op == OP_4XNN || ins.op == OP_5XY0 || ins.op == OP_9XY0 ||
+                ins.op == OP_EX9E || ins.op == OP_EXA1 || ins.op == OP_FX33 || ins.op == OP_FX55)
+                break;
+        }
+        int end = addr;
+
+        if (length == 0)
+            return false;
+
+        // A block cut short continues at a new label
+        Instruction last = at(end - 2);
+        bool falls_through = last.op != OP_00EE && last.op != OP_1NNN && last.op != OP_2NNN && last.op != OP_BNNN &&
+                             last.op != OP_3XNN && last.op != OP_4XNN && last.op != OP_5XY0 && last.op != OP_9XY0 &&
+                             last.op != OP_EX9E && last.op != OP_EXA1;
+        if (falls_through && in_rom(end) && reachable[end] && translatable(at(end).op))
+            leader[end] = true;
+
+        fprintf(out, "b_%03X: // %03X - %03X\n", start, start, end - 2);
+        fprintf(out, "    if (cycles < %d)\n    {\n        c.pc = 0x%03X;\n        goto interpret;\n    }\n", length, start);
+        fprintf(out, "    cycles -= %d;\n", length);
+
+        int ticks = 0;
+        for (int pc = start; pc < end; pc += 2)
+        {
+            Instruction ins = at(pc);
+            translated[pc] = translated[pc + 1] = true;
+            fprintf(out, "    // %03X %04X\n", pc, ins.opcode);
+
+            if (reads_timers(ins.op) && ticks > 0)
+            {
+                fprintf(out, "    c.cycle += %d;\n", ticks);
+                ticks = 0;
+            }
+            if (pc + 2 < end)
+            {
+                straight(ins);
+                ticks++;
+                continue;
+            }
+
+            ticks++;
+            switch (ins.op)
+            {
+            case OP_00EE:
+                settle(ticks, ins.opcode);
+                fprintf(out, "    c.pc = c.stack[(--c.sp) & 0xF] + 2;\n    goto dispatch;\n");
+                break;
+            case OP_1NNN:
+                settle(ticks, ins.opcode);
+                jump(ins.nnn);
+                break;
+            case OP_2NNN:
+                settle(ticks, ins.opcode);
+                fprintf(out, "    c.stack[(c.sp++) & 0xF] = 0x%03X;\n", pc);
+                jump(ins.nnn);
+                break;
+            case OP_BNNN:
+                settle(ticks, ins.opcode);
+                fprintf(out, "    c.pc = 0x%03X + c.V[0x%X];\n    goto dispatch;\n", ins.nnn, quirks.jump_vx ? ins.x : 0);
+                break;
+            case OP_3XNN:
+            case OP_4XNN:
+            case OP_5XY0:
+            case OP_9XY0:
+            case OP_EX9E:
+            case OP_EXA1:
+            {
+                char cond[64];
+                if (ins.op == OP_3XNN || ins.op == OP_4XNN)
+                    sprintf(cond, "c.V[0x%X] %s 0x%02X", ins.x, ins.op == OP_3XNN ? "==" : "!=", ins.nn);
+                else if (ins.op == OP_5XY0 || ins.op == OP_9XY0)
+                    sprintf(cond, "c.V[0x%X] %s c.V[0x%X]", ins.x, ins.op == OP_5XY0 ? "==" : "!=", ins.y);
+                else
+                    sprintf(cond, "%sc.key_down(c.V[0x%X])", ins.op == OP_EX9E ? "" : "!", ins.x);
+                settle(ticks, ins.opcode);
+                fprintf(out, "    if (%s)\n    {\n", cond);
+                jump(pc + 4, "        ");
+                fprintf(out, "    }\n");
+                jump(pc + 2);
+                break;
+            }
+            case OP_FX33:
+            case OP_FX55:
+                straight(ins);
+                settle(ticks, ins.opcode);
+                fprintf(out, "    if (!c.aot)\n    {\n        c.pc = 0x%03X;\n        return cycles;\n    }\n", pc + 2);
+                jump(pc + 2);
+                break;
+            default:
+                straight(ins);
+                settle(ticks, ins.opcode);
+                jump(pc + 2);
+                break;
+            }
+        }
+        fprintf(out, "\n");
+        return true;
+    }
+
+    bool translate(const char *rom_path, const char *name)
+    {
+        int rom_size = rom_end - 0x200;
+
+        fprintf(out, "// Generated by chip8-aot from %s for %s, do not edit\n\n", rom_path, platform_names[platform]);
+        fprintf(out, "#include \"core/aot.h\"\n\n");
+
+        fprintf(out, "static const unsigned char rom[%d] = {", rom_size);
+        for (int i = 0; i < rom_size; i++)
+            fprintf(out, "%s0x%02X,", i % 16 ? " " : "\n    ", memory[0x200 + i]);
+        fprintf(out, "\n};\n\n");
+
+        // Blocks are laid out in address order, cutting one short adds a leader further on
+        for (int addr = 0x200; addr < rom_end; addr++)
+            if (leader[addr] && !translatable(at(addr).op))
+                leader[addr] = false;
+
+        fprintf(out, "static int run(CHIP_8 &c, int cycles)\n{\n");
+
+        // The switch is written after the blocks, so it goes to a separate buffer first
+        FILE *body = out;
+        out = tmpfile();
+        if (!out)
+        {
+            printf("chip8-aot: failed to create a temporary file\n");
+            return false;
+        }
+        int blocks = 0;
+        for (int addr = 0x200; addr < rom_end; addr++)
+            if (leader[addr] && block(addr))
+                blocks++;
+        FILE *blocks_out = out;
+        out = body;
+
+        fprintf(out, "dispatch:\n    switch (c.pc)\n    {\n");
+        for (int addr = 0x200; addr < rom_end; addr++)
+            if (leader[addr])
+                fprintf(out, "    case 0x%03X:\n        goto b_%03X;\n", addr, addr);
+        fprintf(out, "    default:\n        break;\n    }\n");
+        // The interpreted instruction may have written over translated code, same as FX33/FX55 in a block
+        fprintf(out, "interpret:\n    if (cycles <= 0)\n        return 0;\n    c.tick();\n    cycles--;\n"
+                     "    if (!c.aot)\n        return cycles;\n    goto dispatch;\n\n");
+
+        rewind(blocks_out);
+        char chunk[4096];
+        size_t read;
+        while ((read = fread(chunk, 1, sizeof(chunk), blocks_out)) > 0)
+            fwrite(chunk, 1, read, out);
+        fclose(blocks_out);
+        fprintf(out, "}\n\n");
+
+        int ranges = 0;
+        fprintf(out, "static const unsigned short ranges[][2] = {\n");
+        for (int addr = 0x200; addr < rom_end; addr++)
+        {
+            if (!translated[addr] || translated[addr - 1])
+                continue;
+            int end = addr;
+            while (end < rom_end && translated[end])
+                end++;
+            fprintf(out, "    {0x%03X, 0x%03X},\n", addr, end);
+            ranges++;
+        }
+        fprintf(out, "};\n\n");
+
+        static const char *platform_constants[PLATFORM_COUNT] = {"PLATFORM_VIP", "PLATFORM_CHIP48", "PLATFORM_SCHIP", "PLATFORM_XOCHIP"};
+        fprintf(out, "static AotProgram program = {\"%s\", %s, rom, sizeof(rom), ranges, %d, run, NULL};\n",
+                name, platform_constants[platform], ranges);
+        fprintf(out, "static AotRegister registration(&program);\n");
+
+        printf("chip8-aot: %s, %d blocks, %d code ranges\n", rom_path, blocks, ranges);
+        return ranges > 0;
+    }
+};
+
+static const char *base_name(const char *path)
+{
+    const char *name = path;
+    for (const char *p = path; *p; p++)
+        if (*p == '/' || *p == '\\')
+            name = p + 1;
+    return name;
+}
+
+int main(int argc, char **argv)
+{
+    static Translator t;
+    memset(&t, 0, sizeof(t));
+
+    const char *args[3] = {NULL, NULL, NULL};
+    int arg_count = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--platform") && i + 1 < argc)
+        {
+            i++;
+            t.platform = PLATFORM_COUNT;
+            for (int p = 0; p < PLATFORM_COUNT; p++)
+                if (!strcmp(argv[i], platform_names[p]))
+                    t.platform = (Platform)p;
+            if (t.platform == PLATFORM_COUNT)
+            {
+                printf("chip8-aot: unknown platform %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (arg_count < 3)
+            args[arg_count++] = argv[i];
+    }
+
+    if (arg_count < 2)
+    {
+        printf("usage: chip8-aot [--platform vip|chip48|schip|xochip] <rom> <output.cpp> [name]\n");
+        return 1;
+    }
+    build_op_table();
+    t.quirks = platform_quirks[t.platform];
+
+    FILE *file = fopen(args[0], "rb");
+    if (!file)
+    {
+        printf("chip8-aot: failed to open %s\n", args[0]);
+        return 1;
+    }
+    t.rom_end = 0x200 + (int)fread(t.memory + 0x200, 1, (4 * 1024) - 0x200, file);
+    fclose(file);
+
+    t.out = fopen(args[1], "w");
+    if (!t.out)
+    {
+        printf("chip8-aot: failed to create %s\n", args[1]);
+        return 1;
+    }
+
+    t.discover();
+    bool ok = t.translate(args[0], args[2] ? args[2] : base_name(args[0]));
+    fclose(t.out);
+    if (!ok)
+    {
+        printf("chip8-aot: nothing to translate in %s\n", args[0]);
+        remove(args[1]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+// chip8-expand: microbenchmark of the 1bpp to RGBA kernels in core/expand_rgba.h
+//
+//   chip8-expand [--frames N] [scales...]
+//
+// Every kernel the CPU supports expands the same set of random frames at each scale, 1 2 4 8
+// and 10 by default. Output is checked against the scalar kernel before it is timed
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "core/chip8.h"
+#include "core/expand_rgba.h"
+
+#define FRAME_COUNT 16
+
+int main(int argc, char **argv)
+{
+    long long frames = 20000;
+    std::vector<int> scales;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+            frames = atoll(argv[++i]);
+        else if (atoi(argv[i]) > 0)
+            scales.push_back(atoi(argv[i]));
+        else
+        {
+            printf("chip8-expand: unexpected argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (scales.empty())
+    {
+        int defaults[] = {1, 2, 4, 8, 10};
+        scales.assign(defaults, defaults + 5);
+    }
+
+    // A CHIP_8 for its generator, the frames only need to be the same for every kernel
+    CHIP_8 *chip = new CHIP_8();
+    chip->seed_random(1);
+    chip->restart();
+    static unsigned long long displays[FRAME_COUNT][32];
+    chip->random_bytes((unsigned char *)displays, sizeof(displays));
+
+    const unsigned int off = 0xFF101010;
+    const unsigned int on = 0xFFE0E0E0;
+
+    printf("%-6s %-8s %12s %10s\n", "scale", "kernel", "Mpixel/s", "speedup");
+    for (size_t s = 0; s < scales.size(); s++)
+    {
+        int scale = scales[s];
+        size_t pixels = 64 * 32 * (size_t)scale * scale;
+        std::vector<unsigned int> expected(pixels), out(pixels);
+
+        double baseline = 0.0;
+        for (int k = 0; k < EXPAND_KERNEL_COUNT; k++)
+        {
+            if (!expand_kernel_supported((ExpandKernel)k))
+            {
+                printf("%-6d %-8s %12s\n", scale, expand_kernel_names[k], "unsupported");
+                continue;
+            }
+            ExpandRgba expand = expand_kernel((ExpandKernel)k);
+
+            for (int f = 0; f < FRAME_COUNT; f++)
+            {
+                expand_rgba_scalar(displays[f], 32, &expected[0], scale, off, on);
+                expand(displays[f], 32, &out[0], scale, off, on);
+                if (memcmp(&expected[0], &out[0], pixels * sizeof(unsigned int)))
+                {
+                    printf("chip8-expand: %s differs from scalar at scale %d\n", expand_kernel_names[k], scale);
+                    return 1;
+                }
+            }
+
+            unsigned long long start = chip8_clock();
+            for (long long f = 0; f < frames; f++)
+                expand(displays[f % FRAME_COUNT], 32, &out[0], scale, off, on);
+            double seconds = (double)(chip8_clock() - start) / 1e9;
+
+            double rate = frames * (double)pixels / seconds / 1e6;
+            if (k == EXPAND_SCALAR)
+                baseline = rate;
+            printf("%-6d %-8s %12.0f %9.2fx%s\n", scale, expand_kernel_names[k], rate, rate / baseline,
+                   k == expand_best_kernel() ? "  (picked)" : "");
+        }
+    }
+    delete chip;
+    return 0;
+}
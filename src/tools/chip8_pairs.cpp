@@ -0,0 +1,142 @@
+// chip8-pairs: counts which instructions run back to back, to pick the superinstructions
+//
+//   chip8-pairs [--cycles N] [--top N] [roms...]
+//
+// Every rom runs headless through CHIP_8::tick(). A pair is counted when the second
+// instruction runs straight after the first from the next address, which is exactly
+// the dispatch a fused handler saves. Without roms every .ch8 in ./roms is used
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "core/chip8.h"
+
+struct Count
+{
+    int ops[3];
+    unsigned long long hits;
+};
+
+static bool by_hits(const Count &a, const Count &b)
+{
+    return a.hits > b.hits;
+}
+
+static void print(const char *title, std::vector<Count> &counts, int length, int top, unsigned long long total)
+{
+    std::sort(counts.begin(), counts.end(), by_hits);
+    printf("\n%s\n", title);
+    for (int i = 0; i < (int)counts.size() && i < top && counts[i].hits > 0; i++)
+    {
+        char name[32] = "";
+        for (int k = 0; k < length; k++)
+        {
+            strcat(name, op_names[counts[i].ops[k]]);
+            if (k + 1 < length)
+                strcat(name, " ");
+        }
+        printf("  %-16s %14llu %6.2f%%\n", name, counts[i].hits, 100.0 * counts[i].hits / total);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    build_op_table();
+
+    long long cycles = 10000000;
+    int top = 20;
+    std::vector<std::string> roms;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+            cycles = atoll(argv[++i]);
+        else if (!strcmp(argv[i], "--top") && i + 1 < argc)
+            top = atoi(argv[++i]);
+        else
+            roms.push_back(argv[i]);
+    }
+
+    if (roms.empty())
+    {
+        DIR *dir = opendir("./roms");
+        if (!dir)
+        {
+            printf("chip8-pairs: no roms given and ./roms can't be opened\n");
+            return 1;
+        }
+        while (dirent *entry = readdir(dir))
+        {
+            std::string name = entry->d_name;
+            if (name.size() > 4 && name.compare(name.size() - 4, 4, ".ch8") == 0)
+                roms.push_back("./roms/" + name);
+        }
+        closedir(dir);
+        std::sort(roms.begin(), roms.end());
+    }
+
+    static unsigned long long singles[OP_COUNT];
+    static unsigned long long pairs[OP_COUNT][OP_COUNT];
+    static unsigned long long triples[OP_COUNT][OP_COUNT][OP_COUNT];
+    unsigned long long total = 0;
+
+    for (size_t r = 0; r < roms.size(); r++)
+    {
+        CHIP_8 *chip = new CHIP_8();
+        chip->restart();
+        chip->loadfile(roms[r].c_str());
+
+        // Ops of the last two instructions, -1 once the run of sequential addresses breaks
+        int prev[2] = {-1, -1};
+        for (long long i = 0; i < cycles; i++)
+        {
+            int pc = chip->pc;
+            int op = decode(chip->memory[pc & 0xFFF] << 8 | chip->memory[(pc + 1) & 0xFFF]).op;
+            chip->tick();
+
+            singles[op]++;
+            if (prev[1] >= 0)
+                pairs[prev[1]][op]++;
+            if (prev[0] >= 0 && prev[1] >= 0)
+                triples[prev[0]][prev[1]][op]++;
+
+            bool sequential = chip->pc == pc + 2;
+            prev[0] = sequential ? prev[1] : -1;
+            prev[1] = sequential ? op : -1;
+        }
+        total += cycles;
+        printf("%s: %lld instructions\n", roms[r].c_str(), cycles);
+        delete chip;
+    }
+
+    std::vector<Count> counts;
+    for (int a = 0; a < OP_COUNT; a++)
+    {
+        Count c = {{a, 0, 0}, singles[a]};
+        counts.push_back(c);
+    }
+    print("instructions", counts, 1, top, total);
+
+    counts.clear();
+    for (int a = 0; a < OP_COUNT; a++)
+        for (int b = 0; b < OP_COUNT; b++)
+        {
+            Count c = {{a, b, 0}, pairs[a][b]};
+            counts.push_back(c);
+        }
+    print("pairs", counts, 2, top, total);
+
+    counts.clear();
+    for (int a = 0; a < OP_COUNT; a++)
+        for (int b = 0; b < OP_COUNT; b++)
+            for (int t = 0; t < OP_COUNT; t++)
+            {
+                Count c = {{a, b, t}, triples[a][b][t]};
+                counts.push_back(c);
+            }
+    print("triples", counts, 3, top, total);
+    return 0;
+}
@@ -0,0 +1,296 @@
+// chip8-run: runs a rom headless and as fast as the host allows
+//
+//   chip8-run --rom <rom> [--platform vip|chip48|schip|xochip] [--engine name] [--speed ips]
+//             [--cycles N | --frames N] [--seed N] [--input-script file]
+//             [--dump-frame out.pbm] [--stats-json out.json|-]
+//
+// Only the core is linked, no SDL, GL or ImGui. The rom runs in 60 Hz frames of speed / 60
+// instructions with no pacing, the input script is applied at the start of every frame.
+// --cycles wins over --frames, the default is 10000000 cycles. CXNN is seeded with --seed, 0 by default.
+// The platform is vip unless --platform says otherwise
+//
+// The input script has one event per line, blank lines and # comments are skipped:
+//
+//   <frame> <key 0-F> down|up
+//
+// --dump-frame writes the display at the end of the run as a 64x32 PBM, --stats-json writes
+// the run's numbers as JSON, to stdout for -
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "core/chip8.h"
+#include "core/jit_x64.h"
+
+struct KeyEvent
+{
+    unsigned long long frame;
+    int key;
+    bool down;
+};
+
+static bool by_frame(const KeyEvent &a, const KeyEvent &b)
+{
+    return a.frame < b.frame;
+}
+
+// Replays a script of key events against the frame counter of the run
+struct ScriptInput : Input
+{
+    std::vector<KeyEvent> events;
+    size_t next;
+    unsigned long long frame;
+    unsigned char held[16];
+
+    bool load(const char *path)
+    {
+        FILE *file = fopen(path, "r");
+        if (!file)
+        {
+            printf("chip8-run: can't open input script %s\n", path);
+            return false;
+        }
+
+        char line[256];
+        int number = 0;
+        while (fgets(line, sizeof(line), file))
+        {
+            number++;
+            char *text = line + strspn(line, " \t");
+            if (*text == '#' || *text == '\n' || *text == '\r' || *text == 0)
+                continue;
+
+            KeyEvent event;
+            char state[8];
+            if (sscanf(text, "%llu %x %7s", &event.frame, &event.key, state) != 3 || event.key > 0xF ||
+                (strcmp(state, "down") && strcmp(state, "up")))
+            {
+                printf("chip8-run: %s:%d: expected <frame> <key 0-F> down|up\n", path, number);
+                fclose(file);
+                return false;
+            }
+            event.down = !strcmp(state, "down");
+            events.push_back(event);
+        }
+        fclose(file);
+
+        std::stable_sort(events.begin(), events.end(), by_frame);
+        return true;
+    }
+
+    void poll(unsigned char keys[16])
+    {
+        for (; next < events.size() && events[next].frame <= frame; next++)
+            held[events[next].key] = events[next].down;
+        memcpy(keys, held, 16);
+    }
+};
+
+static bool dump_frame(const CHIP_8 &chip, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        printf("chip8-run: can't write %s\n", path);
+        return false;
+    }
+    fprintf(file, "P1\n64 32\n");
+    for (int y = 0; y < 32; y++)
+    {
+        for (int x = 0; x < 64; x++)
+            fputc(chip.pixel(x, y) ? '1' : '0', file);
+        fputc('\n', file);
+    }
+    fclose(file);
+    return true;
+}
+
+// Writes text as a quoted JSON string, quotes, backslashes and control characters escaped
+static void write_json_string(FILE *out, const char *text)
+{
+    fputc('"', out);
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fprintf(out, "\\%c", *c);
+        else if (*c == '\n')
+            fputs("\\n", out);
+        else if (*c == '\r')
+            fputs("\\r", out);
+        else if (*c == '\t')
+            fputs("\\t", out);
+        else if (*c < 0x20)
+            fprintf(out, "\\u%04x", *c);
+        else
+            fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+int main(int argc, char **argv)
+{
+    build_op_table();
+
+    const char *rom = NULL;
+    const char *script = NULL;
+    const char *frame_path = NULL;
+    const char *stats_path = NULL;
+    Engine engine = ENGINE_BATCH;
+    Platform platform = PLATFORM_VIP;
+    int speed = CHIP8_DEFAULT_SPEED;
+    long long cycles = 0;
+    long long frames = 0;
+    unsigned long long seed = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool value = i + 1 < argc;
+        if (!strcmp(argv[i], "--rom") && value)
+            rom = argv[++i];
+        else if (!strcmp(argv[i], "--engine") && value)
+        {
+            i++;
+            int e = 0;
+            while (e < ENGINE_COUNT && strcmp(argv[i], engine_names[e]))
+                e++;
+            if (e == ENGINE_COUNT)
+            {
+                printf("chip8-run: unknown engine %s\n", argv[i]);
+                return 1;
+            }
+            engine = (Engine)e;
+        }
+        else if (!strcmp(argv[i], "--platform") && value)
+        {
+            i++;
+            int p = 0;
+            while (p < PLATFORM_COUNT && strcmp(argv[i], platform_names[p]))
+                p++;
+            if (p == PLATFORM_COUNT)
+            {
+                printf("chip8-run: unknown platform %s\n", argv[i]);
+                return 1;
+            }
+            platform = (Platform)p;
+        }
+        else if (!strcmp(argv[i], "--speed") && value)
+            speed = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--cycles") && value)
+            cycles = atoll(argv[++i]);
+        else if (!strcmp(argv[i], "--frames") && value)
+            frames = atoll(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && value)
+            seed = strtoull(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "--input-script") && value)
+            script = argv[++i];
+        else if (!strcmp(argv[i], "--dump-frame") && value)
+            frame_path = argv[++i];
+        else if (!strcmp(argv[i], "--stats-json") && value)
+            stats_path = argv[++i];
+        else
+        {
+            printf("chip8-run: unexpected argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (!rom)
+    {
+        printf("usage: chip8-run --rom <rom> [--platform name] [--engine name] [--speed ips] [--cycles N | --frames N]\n"
+               "                 [--seed N] [--input-script file] [--dump-frame out.pbm] [--stats-json out.json|-]\n");
+        return 1;
+    }
+
+    ScriptInput input = {};
+    if (script && !input.load(script))
+        return 1;
+
+    CHIP_8 *chip = new CHIP_8();
+    chip->seed_random(seed);
+    chip->restart();
+    if (!chip->loadfile(rom, platform))
+        return 1;
+    chip->set_speed(speed);
+    chip->input = &input;
+
+    JIT_X64 *jit = NULL;
+    if (engine == ENGINE_JIT || engine == ENGINE_TRACE)
+    {
+        jit = new JIT_X64();
+        if (jit->init())
+            chip->jit = jit;
+    }
+
+    unsigned long long target = cycles > 0 ? cycles : frames > 0 ? chip->tick_cycle(frames) : 10000000;
+    RunResult result = RUN_CYCLES_EXHAUSTED;
+
+    unsigned long long start = chip8_clock();
+    while (chip->cycle < target)
+    {
+        input.frame = chip->tick_at(chip->cycle);
+        chip->poll_input();
+
+        // Up to the next frame boundary, execute() stays well inside an int
+        unsigned long long slice = std::min(chip->next_tick_cycle() - chip->cycle, target - chip->cycle);
+        result = chip->execute(engine, (int)slice);
+        if (result == RUN_ILLEGAL_OPCODE)
+            break;
+    }
+    double seconds = (double)(chip8_clock() - start) / 1e9;
+
+    unsigned long long ran = chip->cycle;
+    // Frames the run reached into, the last one may be partial
+    unsigned long long frames_run = ran ? chip->tick_at(ran - 1) + 1 : 0;
+    double ips = seconds > 0.0 ? ran / seconds : 0.0;
+
+    if (frame_path && !dump_frame(*chip, frame_path))
+        return 1;
+
+    bool json_to_stdout = stats_path && !strcmp(stats_path, "-");
+    if (!json_to_stdout)
+        printf("%s: %llu cycles, %llu frames in %.3f s, %.0f ips, %llu skipped idle, %s\n", rom, ran, frames_run,
+               seconds, ips, chip->idle_skipped, run_result_names[result]);
+
+    if (stats_path)
+    {
+        FILE *out = json_to_stdout ? stdout : fopen(stats_path, "w");
+        if (!out)
+        {
+            printf("chip8-run: can't write %s\n", stats_path);
+            return 1;
+        }
+        fprintf(out, "{\n");
+        fprintf(out, "  \"rom\": ");
+        write_json_string(out, rom);
+        fprintf(out, ",\n");
+        fprintf(out, "  \"platform\": \"%s\",\n", platform_names[platform]);
+        fprintf(out, "  \"engine\": \"%s\",\n", engine_names[engine]);
+        fprintf(out, "  \"speed\": %d,\n", speed);
+        fprintf(out, "  \"seed\": %llu,\n", seed);
+        fprintf(out, "  \"cycles\": %llu,\n", ran);
+        fprintf(out, "  \"frames\": %llu,\n", frames_run);
+        fprintf(out, "  \"seconds\": %.6f,\n", seconds);
+        fprintf(out, "  \"ips\": %.0f,\n", ips);
+        fprintf(out, "  \"idle_skipped\": %llu,\n", chip->idle_skipped);
+        if (chip->jit)
+            fprintf(out, "  \"jit\": {\"blocks\": %llu, \"traces\": %llu, \"native\": %llu, \"interpreted\": %llu},\n",
+                    jit->stats.blocks_compiled, jit->stats.traces_compiled, jit->stats.native_instructions,
+                    jit->stats.interpreted_instructions);
+        fprintf(out, "  \"aot\": %s,\n", chip->aot ? "true" : "false");
+        fprintf(out, "  \"result\": \"%s\",\n", run_result_names[result]);
+        fprintf(out, "  \"pc\": %d\n", chip->pc);
+        fprintf(out, "}\n");
+        if (!json_to_stdout)
+            fclose(out);
+    }
+
+    if (jit)
+    {
+        jit->shutdown();
+        delete jit;
+    }
+    delete chip;
+    return result == RUN_ILLEGAL_OPCODE ? 2 : 0;
+}